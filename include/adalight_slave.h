@@ -23,6 +23,10 @@ typedef struct{
 	uint8_t b;
 }tAdalight_RGB;
 
+#ifndef ADALIGHT_SLAVE_SPAN_LEDS
+#define ADALIGHT_SLAVE_SPAN_LEDS (16)  /**< leds of "Ada" frames collected per span callback */
+#endif
+
 /**
  * @brief initializes the peripherals
  */
@@ -34,17 +38,54 @@ void    Adalight_Slave_Init(void);
  */
 void    Adalight_Slave_SetColorReceivedCallback(void (*cb)(uint32_t ledNum, tAdalight_RGB color));
 
+/**
+ * @brief set a callback function, which gets called with ADALIGHT_SLAVE_SPAN_LEDS received leds at once
+ *        (the rest of a frame gets delivered before the frame complete callback), e.g. WS2812_WriteLeds
+ * @param cb: function pointer, rgb holds r, g, b bytes of numLeds leds starting at firstLed
+ */
+void    Adalight_Slave_SetSpanReceivedCallback(void (*cb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb));
+
 /**
  * @brief set a callback function, which gets called, when a the whole frame has been received
  * @param cb: function pointer
  */
 void    Adalight_Slave_SetFrameCompleteCallback(void(*cb)(void));
 
+/**
+ * @brief set a callback function, which gets called, when a palette index of an "Adi" frame gets received
+ * @param cb: function pointer
+ */
+void    Adalight_Slave_SetIndexReceivedCallback(void (*cb)(uint32_t ledNum, uint8_t index));
+
+/**
+ * @brief set a callback function, which gets called, when a palette entry of an "Adp" packet gets received
+ * @param cb: function pointer
+ */
+void    Adalight_Slave_SetPaletteReceivedCallback(void (*cb)(uint32_t entry, tAdalight_RGB color));
+
+/**
+ * @brief set a callback function, which gets called, when a run of an "Adf" frame gets received
+ *        (count leds starting at ledNum have the same color, e.g. WS2812_FillLeds)
+ * @param cb: function pointer
+ */
+void    Adalight_Slave_SetFillReceivedCallback(void (*cb)(uint32_t ledNum, uint32_t count, tAdalight_RGB color));
+
 /**
  * @brief returns 1 if whole frame has been received
  */
 uint8_t Adalight_Slave_FrameComplete(void);
 
+/**
+ * @brief returns the number of leds received in the last frame
+ */
+uint32_t Adalight_Slave_GetLastReceivedLedNumber(void);
+
+/**
+ * @brief feeds one byte into the parser as if it has been received over uart
+ * @param ch: received byte
+ */
+void    Adalight_Slave_InjectByte(uint8_t ch);
+
 
 
 #endif
@@ -0,0 +1,92 @@
+/**
+  ******************************************************************************
+  * @file    stm32f10x_dwt.h
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   DWT cycle counter and per handler cycle budget bookkeeping
+  *
+  * The budgets get only recorded if CYCLE_BUDGET_CHECK is defined (Benchmark
+  * configuration), otherwise the CYCLE_BUDGET_* macros expand to nothing.
+  ******************************************************************************
+  */
+
+#ifndef STM32F10X_DWT_H_INCLUDED
+#define STM32F10X_DWT_H_INCLUDED
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "stm32f10x.h"
+
+/* Exported typedef ----------------------------------------------------------*/
+typedef enum{
+    CycleBudget_WS2812_Refill,    /**< ws2812 dma refill, per WS2812_LEDS_PER_REFILL leds */
+    CycleBudget_WS2812_Latch,     /**< ws2812 latch timer, per frame end / reset gap */
+    CycleBudget_WS2801_Byte,      /**< Spi_Handler, per received byte */
+    CycleBudget_Adalight_Byte,    /**< AdalightParser, per received byte */
+    CycleBudget_Num
+}tCycleBudgetId;
+
+typedef struct{
+    uint32_t budget;    /**< allowed cycles per call */
+    uint32_t max;       /**< maximum measured cycles per call */
+    uint32_t calls;     /**< number of measured calls */
+    uint32_t total;     /**< sum of all measured cycles (overflows after ~59s at 72MHz) */
+    uint32_t overruns;  /**< number of calls which exceeded the budget */
+}tCycleBudget;
+
+/* Exported define -----------------------------------------------------------*/
+#define DWT_CTRL            (*(__IO uint32_t *)0xE0001000)
+#define DWT_CYCCNT          (*(__IO uint32_t *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA  (0x00000001)
+
+/* budgets at 72MHz: a quarter of the time one led / byte takes on the wire */
+#define CYCLE_BUDGET_WS2812_REFILL   (540)   /**< per led: 24 bit * 1.25us = 2160 cycles */
+#define CYCLE_BUDGET_WS2812_LATCH    (1800)  /**< per reset: 50us = 3600 cycles, half as it encodes the start of the next frame */
+#define CYCLE_BUDGET_WS2801_BYTE     (144)   /**< 8 bit @ 1MHz = 576 cycles */
+#define CYCLE_BUDGET_ADALIGHT_BYTE   (1560)  /**< 10 bit @ 115200 baud = 6250 cycles */
+
+/* Exported macro ------------------------------------------------------------*/
+#define DWT_GetCycles()     (DWT_CYCCNT)
+
+#ifdef CYCLE_BUDGET_CHECK
+#define CYCLE_BUDGET_BEGIN()    uint32_t cycleBudgetStart = DWT_GetCycles()
+#define CYCLE_BUDGET_END(id)    CycleBudget_Add((id), DWT_GetCycles() - cycleBudgetStart)
+#else
+#define CYCLE_BUDGET_BEGIN()
+#define CYCLE_BUDGET_END(id)
+#endif
+
+/* Exported variables --------------------------------------------------------*/
+/* Exported function prototypes ----------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief enables the DWT cycle counter
+  */
+void DWT_Init(void);
+
+/**
+  * @brief enables the cycle counter and resets all budgets to their defaults
+  */
+void CycleBudget_Init(void);
+
+/**
+  * @brief records one measured call
+  * @param id: handler which got measured
+  * @param cycles: cycles the call took
+  */
+void CycleBudget_Add(tCycleBudgetId id, uint32_t cycles);
+
+/**
+  * @brief returns the statistics of the given handler
+  * @param id: handler
+  */
+tCycleBudget const * CycleBudget_Get(tCycleBudgetId id);
+
+/**
+  * @brief returns 1 if any handler has exceeded its budget, else 0
+  */
+uint8_t CycleBudget_Exceeded(void);
+
+#endif
@@ -43,6 +43,11 @@ void UART1_SendChar(uint8_t ch);
   */
 void UART1_SendString(char const *str);
 
+/**
+  * @brief blocks until all buffered chars have been sent
+  */
+void UART1_Flush(void);
+
 /**
   * @brief sets a receiver function
   * @param ParserFunc: function pointer to call after interrupt
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    stream_capture.h
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Capture and replay of the raw WS2801 / Adalight input streams
+  *
+  * Capture format (all multi byte values big endian):
+  *   header: 'S','C','A','P', version (1)
+  *   record: tag [delta_hi delta_lo] [data]
+  *     tag bits 7..6: event (see tStreamEvent)
+  *     tag bits 5..0: ms since the previous record, 63 means the delta
+  *                    follows as 16 bit value (saturated at 65535ms)
+  *     data:          received byte, only for byte events
+  *
+  * Recording is only compiled into the isr's if STREAM_CAPTURE is defined.
+  * The reader (StreamCapture_ReaderInit/StreamCapture_Next) has no hardware
+  * dependencies and can be used on a host as well.
+  ******************************************************************************
+  */
+
+#ifndef STREAM_CAPTURE_H_INCLUDED
+#define STREAM_CAPTURE_H_INCLUDED
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported typedef ----------------------------------------------------------*/
+typedef enum{
+    StreamEvent_WS2801_Byte   = 0,   /**< byte received on SPI1 */
+    StreamEvent_WS2801_Latch  = 1,   /**< nss released (frame complete) */
+    StreamEvent_Adalight_Byte = 2,   /**< byte received on UART1 */
+}tStreamEvent;
+
+typedef enum{
+    StreamReplay_Recorded,    /**< keep the recorded gaps between the records */
+    StreamReplay_Maximum,     /**< no gaps, except for gaps the parsers detect as timeout */
+}tStreamReplaySpeed;
+
+typedef struct{
+    tStreamEvent event;       /**< event type */
+    uint8_t      data;        /**< received byte (byte events only) */
+    uint16_t     delta;       /**< ms since the previous record */
+}tStreamRecord;
+
+typedef struct{
+    uint8_t const *pos;       /**< next record */
+    uint8_t const *end;       /**< end of the capture */
+}tStreamReader;
+
+/* Exported define -----------------------------------------------------------*/
+#define STREAM_CAPTURE_HEADER_SIZE   (5)
+#define STREAM_CAPTURE_VERSION       (1)
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef STREAM_CAPTURE
+#define STREAM_CAPTURE_RECORD(event,data)   StreamCapture_Record((event),(data))
+#else
+#define STREAM_CAPTURE_RECORD(event,data)
+#endif
+
+/* Exported variables --------------------------------------------------------*/
+/* Exported function prototypes ----------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/**
+  * @brief starts a new capture into the given buffer (stops when the buffer is full)
+  * @param buffer: buffer to record into
+  * @param size: size of the buffer in bytes
+  */
+void StreamCapture_Start(uint8_t *buffer, uint32_t size);
+
+/**
+  * @brief stops the current capture
+  * @returns number of bytes recorded (including the header)
+  */
+uint32_t StreamCapture_Stop(void);
+
+/**
+  * @brief records one event (gets called from the isr's)
+  * @param event: event type
+  * @param data: received byte, ignored for latch events
+  */
+void StreamCapture_Record(tStreamEvent event, uint8_t data);
+
+/**
+  * @brief initializes a reader on the given capture
+  * @param reader: reader to initialize
+  * @param capture: capture including header
+  * @param length: length of the capture in bytes
+  * @returns 1 if the header is valid, else 0
+  */
+uint8_t StreamCapture_ReaderInit(tStreamReader *reader, uint8_t const *capture, uint32_t length);
+
+/**
+  * @brief decodes the next record
+  * @param reader: reader to operate
+  * @param record: decoded record
+  * @returns 1 if a record has been decoded, 0 at the end of the capture
+  */
+uint8_t StreamCapture_Next(tStreamReader *reader, tStreamRecord *record);
+
+/**
+  * @brief feeds the capture through the parsers of the WS2801 and Adalight slave
+  * @param capture: capture including header
+  * @param length: length of the capture in bytes
+  * @param speed: replay speed
+  * @returns number of replayed records
+  */
+uint32_t StreamCapture_Replay(uint8_t const *capture, uint32_t length, tStreamReplaySpeed speed);
+
+#endif
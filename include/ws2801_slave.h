@@ -23,6 +23,10 @@ typedef struct{
 	uint8_t b;
 }tWS2801_RGB;
 
+#ifndef WS2801_SLAVE_SPAN_LEDS
+#define WS2801_SLAVE_SPAN_LEDS  (8)   /**< leds collected per span callback, the flush runs in the spi isr */
+#endif
+
 /**
  * @brief initializes the peripherals
  */
@@ -34,6 +38,13 @@ void    WS2801_Slave_Init(void);
  */
 void    WS2801_Slave_SetColorReceivedCallback(void (*cb)(uint32_t ledNum, tWS2801_RGB color));
 
+/**
+ * @brief set a callback function, which gets called with WS2801_SLAVE_SPAN_LEDS received leds at once
+ *        (the rest of a frame gets delivered before the frame complete callback), e.g. WS2812_WriteLeds
+ * @param cb: function pointer, rgb holds r, g, b bytes of numLeds leds starting at firstLed
+ */
+void    WS2801_Slave_SetSpanReceivedCallback(void (*cb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb));
+
 /**
  * @brief set a callback function, which gets called, when a the whole frame has been received
  * @param cb: function pointer
@@ -51,6 +62,17 @@ uint8_t WS2801_Slave_FrameComplete(void);
  */
 uint32_t WS2801_Slave_GetLastReceivedLedNumber(void);
 
+/**
+ * @brief feeds one byte into the receiver as if it has been received over spi
+ * @param ch: received byte
+ */
+void    WS2801_Slave_InjectByte(uint8_t ch);
+
+/**
+ * @brief completes the current frame as if nss has been released
+ */
+void    WS2801_Slave_InjectLatch(void);
+
 
 
 
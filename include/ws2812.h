@@ -8,14 +8,193 @@
   *
   * This lib uses a double buffering method with cyclic reload of the
   * DMA to keep the RAM usage at a minimum level
-  * Used Peripherals:  DMA1, TIM4 with output capture compare (PWM)
-  * Output Pin: PB6
+  * Used Peripherals:  DMA1, TIM4 with output capture compare (PWM) or SPI2, TIM3 (latch gap)
+  * Output Pin: PB6 (PWM backend) or PB15 (SPI backend)
   ******************************************************************************
 */
 
 #ifndef WS2812_H_INCLUDED
 #define WS2812_H_INCLUDED
 
+/* supported led types / timing profiles (select with WS2812_LED_TYPE or WS2812_SetTiming) */
+#define WS2812_TYPE_WS2812     (0)
+#define WS2812_TYPE_WS2812B    (1)
+#define WS2812_TYPE_SK6812     (2)
+#define WS2812_TYPE_WS2811     (3)   /**< 400kHz mode */
+#define WS2812_TYPE_WS2813     (4)
+#define WS2812_TYPE_WS2812B_FAST (5) /**< WS2812B with the bit time trimmed to the tolerance edge (975ns, ~28% more fps) */
+
+/* wire order of the colors (select with WS2812_COLOR_ORDER): position of r, g, b (and w) on the wire */
+#define WS2812_ORDER4(r,g,b,w) ((r) | ((g) << 2) | ((b) << 4) | ((w) << 6))
+#define WS2812_ORDER(r,g,b)    WS2812_ORDER4(r,g,b,3)
+#define WS2812_ORDER_RGB       WS2812_ORDER(0,1,2)
+#define WS2812_ORDER_RBG       WS2812_ORDER(0,2,1)
+#define WS2812_ORDER_GRB       WS2812_ORDER(1,0,2)
+#define WS2812_ORDER_GBR       WS2812_ORDER(2,0,1)
+#define WS2812_ORDER_BRG       WS2812_ORDER(1,2,0)
+#define WS2812_ORDER_BGR       WS2812_ORDER(2,1,0)
+#define WS2812_ORDER_RGBW      WS2812_ORDER4(0,1,2,3)
+#define WS2812_ORDER_GRBW      WS2812_ORDER4(1,0,2,3)   /**< SK6812 RGBW */
+
+#ifndef WS2812_COLOR_ORDER
+#define WS2812_COLOR_ORDER     WS2812_ORDER_GRB
+#endif
+
+/* output backends (select with WS2812_BACKEND) */
+#define WS2812_BACKEND_PWM     (0)   /**< TIM4 CH1 on PB6, DMA1 channel 1, one refill interrupt per led */
+#define WS2812_BACKEND_SPI     (1)   /**< SPI2 MOSI on PB15, DMA1 channel 5, 3 spi bits per bit */
+
+#ifndef WS2812_BACKEND
+#define WS2812_BACKEND         WS2812_BACKEND_PWM
+#endif
+
+#ifndef WS2812_SPI_LEDS_PER_HALF
+#define WS2812_SPI_LEDS_PER_HALF (8)  /**< leds encoded per refill interrupt with the spi backend */
+#endif
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+#define WS2812_LEDS_PER_REFILL WS2812_SPI_LEDS_PER_HALF
+#else
+#define WS2812_LEDS_PER_REFILL (1)
+#endif
+
+/* 32 bit rgbw leds (e.g. SK6812 RGBW) instead of 24 bit rgb */
+#ifndef WS2812_RGBW
+#define WS2812_RGBW            (0)
+#endif
+
+/* rgbw only: moves the common part of r, g and b to the white channel while encoding (subtracts min(r,g,b) from
+ * them), for leds without white: set with WS2812_SetLed or WS2812_SetLed16, or with WS2812_SetLedRGBW and a white
+ * of 0 (the framebuffer can't tell them apart). Colors with white get sent as they are */
+#ifndef WS2812_WHITE_EXTRACTION
+#define WS2812_WHITE_EXTRACTION (1)
+#endif
+
+/* framebuffer formats (select with WS2812_PIXEL_FORMAT) */
+#define WS2812_FORMAT_RGB888   (0)   /**< 8 bit per channel */
+#define WS2812_FORMAT_RGB16    (1)   /**< 16 bit per channel, temporal dithered to 8 bit at the maximum refresh rate */
+#define WS2812_FORMAT_PALETTE  (2)   /**< 8 bit index into a 256 color palette per led */
+#define WS2812_FORMAT_RGB565   (3)   /**< 16 bit rgb 5-6-5 per led, expanded to 8 bit per channel while encoding */
+
+#ifndef WS2812_PIXEL_FORMAT
+#define WS2812_PIXEL_FORMAT    WS2812_FORMAT_RGB888
+#endif
+
+/* bytes per led in the framebuffer (WS2812_GetBackBuffer), the channels are in wire order */
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+#define WS2812_PIXEL_BYTES     (1)
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+#define WS2812_PIXEL_BYTES     (2)
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+#define WS2812_PIXEL_BYTES     (WS2812_RGBW ? 8 : 6)
+#else
+#define WS2812_PIXEL_BYTES     (WS2812_RGBW ? 4 : 3)
+#endif
+
+/* short strips: WS2812_Refresh encodes the whole frame and one dma transfer sends it without refill
+ * interrupts. Needs a dma buffer of 24 / 9 bytes (pwm / spi) per led, can't be used with WS2812_FORMAT_RGB16.
+ * Brightness, gamma and white balance changes during a transfer take effect with the next refresh */
+#ifndef WS2812_FULL_FRAME
+#define WS2812_FULL_FRAME      (0)
+#endif
+
+/* single framebuffer: the set functions write into the frame which gets sent, twice the leds fit into the ram.
+ * Writes to leds the encoder hasn't reached yet show up in the frame on the wire and get counted as tears
+ * (WS2812_GetTearCount), writes behind it are safe. WS2812_Refresh doesn't copy the frame anymore.
+ * Can't be used with WS2812_INTERPOLATION */
+#ifndef WS2812_SINGLE_BUFFER
+#define WS2812_SINGLE_BUFFER   (0)
+#endif
+
+/* run length encoded framebuffer: a frame is a list of runs instead of a pixel per led. A fill run holds one
+ * color for up to 32767 leds, a literal run one color per led for content which doesn't repeat (the raw
+ * fallback), so the ram scales with the content and not with the led count. The set functions append to the
+ * frame: a write at led 0 starts it over, a gap up to the written led gets filled with leds of the value 0 and
+ * leds below the end of the frame can't be changed anymore. Writes which don't fit into WS2812_RLE_RUNS runs
+ * and WS2812_RLE_COLORS colors (or go below the end) get dropped and counted (WS2812_GetRleDrops).
+ * The encoder decodes the runs in order, so it can't be used with WS2812_REMAP, WS2812_SCALING,
+ * WS2812_INTERPOLATION, WS2812_SMOOTHING or WS2812_SINGLE_BUFFER, WS2812_GetBackBuffer returns 0 */
+#ifndef WS2812_RLE
+#define WS2812_RLE             (0)
+#endif
+
+#ifndef WS2812_RLE_RUNS
+#define WS2812_RLE_RUNS        (256)    /**< runs per frame */
+#endif
+
+#ifndef WS2812_RLE_COLORS
+#define WS2812_RLE_COLORS      (512)    /**< colors per frame, one per fill run and one per led of a literal run */
+#endif
+
+#if WS2812_SINGLE_BUFFER
+#define WS2812_LED_NUM_SCALE   (2)    /**< the ram of the second framebuffer holds leds */
+#else
+#define WS2812_LED_NUM_SCALE   (1)
+#endif
+
+#ifndef WS2812_MAX_LED_NUM
+#if WS2812_FULL_FRAME
+#define WS2812_MAX_LED_NUM     (200)                /**< maximum number of leds */
+#elif WS2812_RLE
+#define WS2812_MAX_LED_NUM     (3000)               /**< maximum number of leds, only the runs take ram */
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+#define WS2812_MAX_LED_NUM     (600 * WS2812_LED_NUM_SCALE)    /**< maximum number of leds */
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+#define WS2812_MAX_LED_NUM     (3000 * WS2812_LED_NUM_SCALE)   /**< maximum number of leds */
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+#define WS2812_MAX_LED_NUM     (1500 * WS2812_LED_NUM_SCALE)   /**< maximum number of leds */
+#else
+#define WS2812_MAX_LED_NUM     (1000 * WS2812_LED_NUM_SCALE)   /**< maximum number of leds */
+#endif
+#endif
+
+/* remap stage between framebuffer and encoder (serpentine matrices, reversed or mirrored segments),
+ * see WS2812_SetRemapTable / WS2812_SetRemapRuns */
+#ifndef WS2812_REMAP
+#define WS2812_REMAP           (0)
+#endif
+
+/* scaling stage: the refreshed leds get stretched (or shrunk) to a longer strip while encoding,
+ * see WS2812_SetScaling */
+#define WS2812_SCALE_NEAREST   (0)
+#define WS2812_SCALE_LINEAR    (1)
+
+#ifndef WS2812_SCALING
+#define WS2812_SCALING         (0)
+#endif
+
+/* temporal interpolation: until the next refresh the frames get sent again at the maximum rate, crossfaded
+ * from the previous to the last refreshed frame over 3/4 of the measured refresh interval (so jittered frames
+ * don't cut the fade off). Needs a third framebuffer */
+#ifndef WS2812_INTERPOLATION
+#define WS2812_INTERPOLATION   (0)
+#endif
+
+/* temporal smoothing: exponential filter per output led, the frames get sent again until the leds have
+ * settled, so the host only has to send changes. Needs 2 bytes per channel and led of filter state */
+#ifndef WS2812_SMOOTHING
+#define WS2812_SMOOTHING       (0)
+#endif
+
+/* duplicate frames: WS2812_Refresh compares the crc (crc unit) of the frame with the last one and skips
+ * frames which are already on the leds */
+#ifndef WS2812_DEDUP
+#define WS2812_DEDUP           (0)
+#endif
+
+/* power limit: estimates the current of each refreshed frame from the channel sums of the refreshed leds
+ * (kept up to date by the set functions) and scales it down through the color correction if it exceeds the budget */
+#ifndef WS2812_POWER_LIMIT
+#define WS2812_POWER_LIMIT     (0)
+#endif
+
+#ifndef WS2812_LED_TYPE
+#define WS2812_LED_TYPE        WS2812_TYPE_WS2812B  /**< led type the waveform gets checked against */
+#endif
+
+#ifndef WS2812_TIM_CLOCK_KHZ
+#define WS2812_TIM_CLOCK_KHZ   (72000)              /**< TIM4 clock the default profile gets checked against at compile time */
+#endif
 
 typedef struct{
 	uint8_t r;
@@ -23,11 +202,57 @@ typedef struct{
 	uint8_t b;
 }tWS2812_RGB;
 
+typedef struct{
+	uint16_t r;
+	uint16_t g;
+	uint16_t b;
+}tWS2812_RGB16;
+
+typedef struct{
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t w;
+}tWS2812_RGBW;
+
+#if WS2812_REMAP
+/* run of the remap list: count leds starting at framebuffer led start, step apart, sent repeat times */
+typedef struct{
+	uint16_t start;    /**< first framebuffer led */
+	uint16_t count;    /**< leds in the run (1 ... ) */
+	int8_t   step;     /**< framebuffer leds between two outputs: 1 ... forward, -1 ... reversed, 0 ... one led */
+	uint8_t  repeat;   /**< how often the run gets sent (0 and 1 ... once) */
+}tWS2812_Run;
+#endif
+
+#if WS2812_DEDUP
+typedef struct{
+	uint32_t frames;       /**< refreshed frames */
+	uint32_t duplicates;   /**< frames which have been skipped, hit rate = duplicates / frames */
+}tWS2812_DedupStats;
+#endif
+
+#if WS2812_POWER_LIMIT
+typedef struct{
+	uint16_t r, g, b;      /**< current of the channel at full brightness in uA (~20000 for a WS2812B) */
+	uint16_t w;            /**< white channel, WS2812_RGBW only */
+	uint16_t idle;         /**< current of a dark led in uA (~600 for a WS2812B) */
+}tWS2812_PowerModel;
+#endif
+
 /**
  * @brief initializes the peripherals and the lib
  */
 void WS2812_Init	(void);
 
+/**
+ * @brief Switches to the timing profile of another led type, the ticks get calculated from the current
+ *        TIM4 clock (call it again after changing the system clock). Waits until the current frame has been sent
+ * @param ledType: WS2812_TYPE_xxx
+ * @return 1 if the profile has been applied, 0 if it can't be met with the current clock (old timing is kept)
+ */
+uint8_t WS2812_SetTiming(uint8_t ledType);
+
 /**
  * @brief Sets the led on lednum (first one starts with 0) with the given color
  * @param lednum: led to set
@@ -35,6 +260,49 @@ void WS2812_Init	(void);
  */
 void WS2812_SetLed(uint32_t lednum, tWS2812_RGB const * color);
 
+/**
+ * @brief Sets the led on lednum with a 16 bit per channel color (gets rounded if WS2812_FORMAT_RGB16 isn't used)
+ * @param lednum: led to set
+ * @param color:  color to set
+ */
+void WS2812_SetLed16(uint32_t lednum, tWS2812_RGB16 const * color);
+
+#if WS2812_RGBW
+/**
+ * @brief Sets the led on lednum with a rgbw color (WS2812_RGBW only)
+ *        WS2812_SetLed and WS2812_SetLed16 clear the white channel, the palette and rgb565 formats drop it.
+ *        With WS2812_WHITE_EXTRACTION a color with a white of 0 gets extracted like a rgb color
+ *        (RGBW(100,100,100,0) goes out as (0,0,0,100))
+ * @param lednum: led to set
+ * @param color:  color to set
+ */
+void WS2812_SetLedRGBW(uint32_t lednum, tWS2812_RGBW const * color);
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+/**
+ * @brief Sets the palette index of the led on lednum (WS2812_FORMAT_PALETTE only). WS2812_SetLed and the
+ *        other set functions store the rgb 3-3-2 index of the color, which matches the default palette
+ * @param lednum: led to set
+ * @param index:  palette entry
+ */
+void WS2812_SetLedIndex(uint32_t lednum, uint8_t index);
+
+/**
+ * @brief Sets palette entries of the next frame, takes effect with the next refresh (WS2812_FORMAT_PALETTE only)
+ * @param first: first entry to set
+ * @param numColors: number of entries
+ * @param colors: new colors
+ */
+void WS2812_SetPalette(uint32_t first, uint32_t numColors, tWS2812_RGB const * colors);
+
+/**
+ * @brief Returns the palette index of the requested led (WS2812_FORMAT_PALETTE only)
+ * @param lednum: led number
+ */
+uint8_t WS2812_GetLedIndex(uint32_t lednum);
+#endif
+
 /**
  * @brief Sets the first n leds with the given color
  * @param numLeds: how much leds should get set
@@ -43,7 +311,52 @@ void WS2812_SetLed(uint32_t lednum, tWS2812_RGB const * color);
 void WS2812_SetAllLeds(uint32_t numLeds, tWS2812_RGB const * color);
 
 /**
- * @brief Starts transmitting the led data to the peripheral (this function can block if, old transmission hasn't completed)
+ * @brief Sets a run of leds to one color, e.g. a run length encoded frame run by run. The color gets converted
+ *        once (and accounted once with WS2812_POWER_LIMIT) and written 4 leds as 3 words with
+ *        WS2812_FORMAT_RGB888 (no rgbw). Leds above WS2812_MAX_LED_NUM get ignored
+ * @param first:   first led of the run
+ * @param numLeds: leds in the run
+ * @param color:   color to set
+ */
+void WS2812_FillLeds(uint32_t first, uint32_t numLeds, tWS2812_RGB const * color);
+
+/**
+ * @brief Sets a run of leds from r, g, b bytes (e.g. a received WS2801 or Adalight frame). Gets copied in one go
+ *        if the framebuffer holds the bytes in the same order (WS2812_FORMAT_RGB888 with WS2812_ORDER_RGB),
+ *        otherwise reordered 4 leds as 3 words with WS2812_FORMAT_RGB888 (no rgbw) and led by led in the other
+ *        formats. Leds above WS2812_MAX_LED_NUM get ignored
+ * @param first:   first led to set
+ * @param numLeds: leds to set
+ * @param rgb:     3 bytes per led
+ */
+void WS2812_WriteLeds(uint32_t first, uint32_t numLeds, uint8_t const * rgb);
+
+/**
+ * @brief Copies a run of leds within the next frame, the runs may overlap. With WS2812_RLE the copies get
+ *        appended like any other write, each source led gets searched in the runs
+ * @param dst:     first led to set
+ * @param src:     first led to copy from
+ * @param numLeds: leds to copy
+ */
+void WS2812_CopyLeds(uint32_t dst, uint32_t src, uint32_t numLeds);
+
+/**
+ * @brief Returns the framebuffer of the next frame for producers which write the pixels directly:
+ *        WS2812_MAX_LED_NUM leds of WS2812_PIXEL_BYTES in the format of WS2812_PIXEL_FORMAT, channels in wire order.
+ *        The buffer changes with every refresh (get it again afterwards). With WS2812_POWER_LIMIT the next refresh
+ *        recounts the refreshed leds, with WS2812_SINGLE_BUFFER these writes aren't checked for tears.
+ *        0 with WS2812_RLE, the runs can't be written directly
+ */
+void * WS2812_GetBackBuffer(void);
+
+/**
+ * @brief Starts transmitting the led data to the peripheral, doesn't wait for a running transmission:
+ *        the frame gets sent after it (the latch isr takes it over) and the set functions write into it until then,
+ *        a later refresh before that replaces it. A repeated frame gets cut short for it
+ *        With WS2812_FORMAT_RGB16 the frame gets repeated with the next dither step until the next refresh,
+ *        with WS2812_INTERPOLATION with the next crossfade step (and with WS2812_SMOOTHING until it settles)
+ *        With a remap or scaling these set the output length, numLeds the framebuffer leds in use
+ *        With WS2812_DEDUP a frame equal to the last one returns at once without a transfer (and its callback)
  * @param numLeds: how much leds should get refreshed
  */
 void WS2812_Refresh(uint32_t numLeds);
@@ -54,6 +367,20 @@ void WS2812_Refresh(uint32_t numLeds);
  */
 tWS2812_RGB WS2812_GetLed(uint32_t lednum);
 
+/**
+ * @brief Returns the 16 bit per channel color of the requested led
+ * @param lednum: led number
+ */
+tWS2812_RGB16 WS2812_GetLed16(uint32_t lednum);
+
+#if WS2812_RGBW
+/**
+ * @brief Returns the rgbw color of the requested led (WS2812_RGBW only)
+ * @param lednum: led number
+ */
+tWS2812_RGBW WS2812_GetLedRGBW(uint32_t lednum);
+#endif
+
 /**
  * @brief Returns 1 if Transfer has been completed
  */
@@ -61,8 +388,109 @@ uint8_t WS2812_TransferComplete(void);
 
 /**
  * @brief Sets a callback function which gets called, when the transfer has been completed (get called in an ISR)
+ *        Frames which get repeated (dithering, interpolation, smoothing) count as complete after their first transfer
  */
 void WS2812_SetTransferCompleteCallback(void (*cb)(void));
 
+/**
+ * @brief Sets the gamma of the color correction (applied while encoding, takes effect with the next frame)
+ * @param gamma: gamma * 100 (100 ... linear, 220 ... gamma 2.2)
+ */
+void WS2812_SetGamma(uint16_t gamma);
+
+/**
+ * @brief Sets the global brightness, the current frame gets sent again with it
+ * @param value: 0 ... off, 255 ... full brightness
+ */
+void WS2812_SetBrightness(uint8_t value);
+
+/**
+ * @brief Sets the white balance (maximum value of each channel), the current frame gets sent again with it
+ *        The white channel of rgbw leds is only scaled by the brightness
+ * @param r, g, b: 255 ... no correction
+ */
+void WS2812_SetWhiteBalance(uint8_t r, uint8_t g, uint8_t b);
+
+#if WS2812_DEDUP
+/**
+ * @brief Returns the number of refreshed and skipped duplicate frames since the start
+ */
+tWS2812_DedupStats WS2812_GetDedupStats(void);
+#endif
+
+#if WS2812_SINGLE_BUFFER
+/**
+ * @brief Returns the number of writes which went into leds the frame on the wire still had to send
+ *        (WS2812_SINGLE_BUFFER only). A write call counts once, no matter how many leds it touched
+ */
+uint32_t WS2812_GetTearCount(void);
+#endif
+
+#if WS2812_RLE
+/**
+ * @brief Returns the number of writes which got dropped (WS2812_RLE only): no run or color left for them or
+ *        below the end of the frame. A write call counts once, no matter how many leds it touched
+ */
+uint32_t WS2812_GetRleDrops(void);
+#endif
+
+#if WS2812_POWER_LIMIT
+/**
+ * @brief Sets the current model of the leds and the budget, frames above it get dimmed evenly
+ *        (takes effect with the next refresh). The gamma curve isn't modeled, the estimate is an upper bound
+ * @param model: current per channel and led
+ * @param budgetMa: maximum current of the strip in mA, 0 ... no limit
+ */
+void WS2812_SetPowerLimit(tWS2812_PowerModel const * model, uint32_t budgetMa);
+
+/**
+ * @brief Returns the estimated current of the last refreshed frame in mA before limiting
+ */
+uint32_t WS2812_GetPowerEstimate(void);
+#endif
+
+#if WS2812_SMOOTHING
+/**
+ * @brief Sets the temporal smoothing, each frame moves the leds by (256 - factor) / 256 towards the refreshed colors
+ *        (applied while encoding, takes effect with the next frame)
+ * @param factor: 0 ... off, 128 ... half way per frame, 255 ... slowest
+ */
+void WS2812_SetSmoothing(uint8_t factor);
+#endif
+
+#if WS2812_SCALING
+/**
+ * @brief Stretches the leds of each refresh to numLeds output leds (e.g. 30 received leds to a 90 led strip),
+ *        the scaled strip gets computed while encoding. Waits until the current frame has been sent
+ * @param numLeds: output leds, 0 ... scaling off
+ * @param mode: WS2812_SCALE_NEAREST (repeats leds) or WS2812_SCALE_LINEAR (interpolates between leds)
+ * @return 1 if the scaling has been applied, 0 if numLeds is too long or the mode is unknown
+ */
+uint8_t WS2812_SetScaling(uint32_t numLeds, uint8_t mode);
+#endif
+
+#if WS2812_REMAP
+/**
+ * @brief Sends led table[i] of the framebuffer as output led i (the table isn't copied and has to stay valid).
+ *        The output length is the table length, leds above the number passed to WS2812_Refresh get sent dark.
+ *        With WS2812_SetScaling the table points into the scaled strip instead of the framebuffer.
+ *        Waits until the current frame has been sent, takes effect with the next frame
+ * @param table: framebuffer led of each output led, 0 ... remap off
+ * @param length: output leds
+ * @return 1 if the table has been applied, 0 if it is too long or points outside the framebuffer
+ */
+uint8_t WS2812_SetRemapTable(uint16_t const * table, uint32_t length);
+
+/**
+ * @brief Sends the runs one after another (the list isn't copied and has to stay valid), e.g. a 8x8 serpentine
+ *        matrix as {0,8,1,1}, {15,8,-1,1}, {16,8,1,1}, ... or a reversed 60 led segment sent 3 times as {59,60,-1,3}
+ *        The output length is the sum of all runs, otherwise like WS2812_SetRemapTable
+ * @param runs: run list, 0 ... remap off
+ * @param numRuns: entries of the list
+ * @return 1 if the list has been applied, 0 if it is too long or points outside the framebuffer
+ */
+uint8_t WS2812_SetRemapRuns(tWS2812_Run const * runs, uint32_t numRuns);
+#endif
+
 
 #endif
@@ -6,6 +6,12 @@
   * @date    18.07.2019
   * @brief   Simple Slave for the Adalight UART protocol
   *
+  * Besides the rgb frames ("Ada") it accepts palette and run length encoded frames:
+  * "Adp" first (count-1) checksum + count * 3 color bytes ... palette entries
+  * "Adi" hi lo checksum + one palette index per led        ... indexed frame
+  * "Adf" hi lo checksum + runs of count hi, count lo + 3 color bytes until
+  *       the hi lo leds are filled                          ... run length encoded frame
+  *
   * Used Peripherals:  UART1
   * Output Pin: PA9  ... UART_TX
   * Input Pin:  PA10 ... UART_RX
@@ -15,24 +21,41 @@
 #include "adalight_slave.h"
 #include "stm32f10x_uart1.h"
 #include "stm32f10x_systick.h"
+#include "stm32f10x_dwt.h"
+#include "stream_capture.h"
 #include <string.h>
 
 static void (*colorCompleteCb)(uint32_t ledNum, tAdalight_RGB color) = 0;
 static void (*frameCompleteCb)(void) = 0;
+static void (*indexReceivedCb)(uint32_t ledNum, uint8_t index) = 0;
+static void (*paletteReceivedCb)(uint32_t entry, tAdalight_RGB color) = 0;
+static void (*fillReceivedCb)(uint32_t ledNum, uint32_t count, tAdalight_RGB color) = 0;
+static void (*spanReceivedCb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb) = 0;
+
+typedef enum{
+	Packet_Leds,Packet_Indices,Packet_Palette,Packet_Fill,
+}tPacketType;
 
 static uint8_t  frameComplete = 0;
 static uint32_t ledNum = 0;
 static uint32_t packetLength = 0;
+static uint32_t receivedLedNum = 0;
+static uint32_t runLength = 0;
+static uint8_t  spanData[3 * ADALIGHT_SLAVE_SPAN_LEDS];   /**< r, g, b of the leds received since the last span */
+static uint32_t spanLeds = 0;
+static tPacketType packetType = Packet_Leds;
 static tAdalight_RGB color;
 
 static void AdalightParser(uint8_t ch);
+static void Flush_Span(void);
+static void UartHandler(uint8_t ch);
 
 void    Adalight_Slave_Init(void){
 	//UART1_init(0x90);   // baud 500000
 	//UART1_init(0x139);  // baud 100000
 
 	UART1_init(UART1_BAUD_115200);
-	UART1_SetReceiveParser(AdalightParser);
+	UART1_SetReceiveParser(UartHandler);
 	UART1_SendString("Ada");
 }
 
@@ -44,15 +67,45 @@ void    Adalight_Slave_SetFrameCompleteCallback(void(*cb)(void)){
 	frameCompleteCb = cb;
 }
 
+void    Adalight_Slave_SetSpanReceivedCallback(void (*cb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb)){
+	spanReceivedCb = cb;
+}
+
+void    Adalight_Slave_SetIndexReceivedCallback(void (*cb)(uint32_t ledNum, uint8_t index)){
+	indexReceivedCb = cb;
+}
+
+void    Adalight_Slave_SetPaletteReceivedCallback(void (*cb)(uint32_t entry, tAdalight_RGB color)){
+	paletteReceivedCb = cb;
+}
+
+void    Adalight_Slave_SetFillReceivedCallback(void (*cb)(uint32_t ledNum, uint32_t count, tAdalight_RGB color)){
+	fillReceivedCb = cb;
+}
+
 uint8_t Adalight_Slave_FrameComplete(void){
 	return frameComplete;
 }
 
+uint32_t Adalight_Slave_GetLastReceivedLedNumber(void){
+	return receivedLedNum;
+}
+
+void    Adalight_Slave_InjectByte(uint8_t ch){
+	AdalightParser(ch);
+}
+
+static void UartHandler(uint8_t ch){
+	STREAM_CAPTURE_RECORD(StreamEvent_Adalight_Byte,ch);
+	AdalightParser(ch);
+}
+
 
 
 void AdalightParser(uint8_t ch){
+	CYCLE_BUDGET_BEGIN();
 	typedef enum{
-		Header,LedG,LedR,LedB,
+		Header,LedG,LedR,LedB,LedIndex,RunHi,RunLo,
 	}tReceiveState;
 	static tReceiveState state = Header;
 	static uint32_t last = 0;
@@ -64,6 +117,7 @@ void AdalightParser(uint8_t ch){
 	if(now-last > 10){
 		state = Header;
 		ledNum  = 0;
+		spanLeds = 0;
 		memset(&color,0,sizeof(tAdalight_RGB));
 	}
 
@@ -73,7 +127,10 @@ void AdalightParser(uint8_t ch){
 
 			if((cnt == 0) && (ch == 'A')){ cnt++; }
 			else if((cnt == 1) && (ch == 'd')){ cnt++; }
-			else if((cnt == 2) && (ch == 'a')){ cnt++; }
+			else if((cnt == 2) && (ch == 'a')){ packetType = Packet_Leds; cnt++; }
+			else if((cnt == 2) && (ch == 'i')){ packetType = Packet_Indices; cnt++; }
+			else if((cnt == 2) && (ch == 'p')){ packetType = Packet_Palette; cnt++; }
+			else if((cnt == 2) && (ch == 'f')){ packetType = Packet_Fill; cnt++; }
 			else if(cnt == 3){
 				packetLength = ((uint32_t)(ch)) << 8; cnt++;
 			}
@@ -82,13 +139,18 @@ void AdalightParser(uint8_t ch){
 			}
 			else if(cnt == 5){
 				if(ch == (((uint8_t)(packetLength>>8)) ^ ((uint8_t)(packetLength)) ^ 0x55)){
-					state = LedG;
+					state = (packetType == Packet_Indices) ? LedIndex : (packetType == Packet_Fill) ? RunHi : LedG;
 					ledNum = 0;
+					if(packetType == Packet_Palette){
+						// first entry, count - 1
+						ledNum = packetLength >> 8;
+						packetLength = ledNum + (packetLength & 0xFF) + 1;
+					}
 				}
 				else{
-					cnt = 0;
 					packetLength = 0;
 				}
+				cnt = 0;
 			}
 			else{
 				cnt = 0;
@@ -105,28 +167,89 @@ void AdalightParser(uint8_t ch){
 		}break;
 		case LedB:{
 				color.b = ch;
+				uint32_t count = 1;
 
-				if(colorCompleteCb!=0){
-					colorCompleteCb(ledNum,color);
+				if(packetType == Packet_Palette){
+					if(paletteReceivedCb != 0){
+						paletteReceivedCb(ledNum,color);
+					}
+				}
+				else if(packetType == Packet_Fill){
+					// the last run ends with the frame
+					count = (runLength < packetLength - ledNum) ? runLength : packetLength - ledNum;
+					if(fillReceivedCb != 0 && count != 0){
+						fillReceivedCb(ledNum,count,color);
+					}
+				}
+				else{
+					if(colorCompleteCb!=0){
+						colorCompleteCb(ledNum,color);
+					}
+					if(spanReceivedCb != 0){
+						uint8_t *rgb = &spanData[3 * spanLeds++];
+						rgb[0] = color.r;
+						rgb[1] = color.g;
+						rgb[2] = color.b;
+					}
 				}
 
 				memset(&color,0,sizeof(tAdalight_RGB));
-				ledNum++;
+				ledNum += count;
+				if(spanLeds == ADALIGHT_SLAVE_SPAN_LEDS){
+					Flush_Span();
+				}
 
 				if(ledNum < packetLength){
-					state = LedG;
+					state = (packetType == Packet_Fill) ? RunHi : LedG;
 				}
 				else{
 					state = Header;
 
+					if(packetType != Packet_Palette){
+						Flush_Span();
+						receivedLedNum = ledNum;
+
+						if(frameCompleteCb != 0){
+							frameCompleteCb();
+						}
+					}
+				}
+
+		}break;
+		case LedIndex:{
+				if(indexReceivedCb != 0){
+					indexReceivedCb(ledNum,ch);
+				}
+				ledNum++;
+
+				if(ledNum >= packetLength){
+					state = Header;
+					receivedLedNum = ledNum;
+
 					if(frameCompleteCb != 0){
 						frameCompleteCb();
 					}
 				}
-
+		}break;
+		case RunHi:{
+				runLength = ((uint32_t)(ch)) << 8;
+				state = RunLo;
+		}break;
+		case RunLo:{
+				runLength |= (uint32_t)(ch);
+				state = LedG;
 		}break;
 		default: state = Header; break;
 	}
 
 	last = now;
+	CYCLE_BUDGET_END(CycleBudget_Adalight_Byte);
+}
+
+// hands the collected leds of the "Ada" frame to the span callback
+static void Flush_Span(void){
+	if(spanLeds != 0 && spanReceivedCb != 0){
+		spanReceivedCb(ledNum - spanLeds,spanLeds,spanData);
+	}
+	spanLeds = 0;
 }
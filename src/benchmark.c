@@ -0,0 +1,303 @@
+/**
+  ******************************************************************************
+  * @file    benchmark.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Self benchmark, replaces main.c if WS2812_BENCHMARK is defined
+  *
+  * Sends synthetic frames through the WS2801 and Adalight parsers into the
+  * WS2812 lib and prints the achieved frames/s, the isr load of the output
+  * (dma refill, latch timer and refresh) and the idle loop headroom for
+  * several led counts over UART1 (115200 baud), and the cycles per led of the
+  * per led and the span set functions.
+  * Needs CYCLE_BUDGET_CHECK for the isr load (see "Benchmark" configuration).
+  ******************************************************************************
+*/
+
+#ifdef WS2812_BENCHMARK
+
+#include <string.h>
+#include "stm32f10x.h"
+#include "ws2812.h"
+#include "ws2801_slave.h"
+#include "adalight_slave.h"
+#include "stm32f10x_uart1.h"
+#include "stm32f10x_systick.h"
+#include "stm32f10x_dwt.h"
+
+#define MEASURE_CYCLES   (SystemCoreClock)   /**< duration of one run (1s) */
+#define SPAN_LEDS        (100)               /**< leds per call of the span benchmark */
+
+typedef enum{
+	Source_WS2801,Source_Adalight,
+}tSource;
+
+static uint32_t const ledCounts[] = {10, 100, 500, 1000, WS2812_MAX_LED_NUM};
+
+static volatile uint8_t  frameSent = 1;
+static volatile uint32_t framesSent = 0;
+static uint32_t idleItersPerRun = 0;
+static uint32_t refreshCycles = 0;    /**< spent in WS2812_Refresh, on the target it runs in the receive isr */
+
+// Callback function for setting the leds
+static void setLedWS2801(uint32_t lednum, tWS2801_RGB color){
+	tWS2812_RGB rgb;
+	memcpy(&rgb,&color,sizeof(color));
+	WS2812_SetLed(lednum,&rgb);
+}
+
+static void setLedAdalight(uint32_t lednum, tAdalight_RGB color){
+	tWS2812_RGB rgb;
+	memcpy(&rgb,&color,sizeof(color));
+	WS2812_SetLed(lednum,&rgb);
+}
+
+// Callback functions for refreshing the leds, they count as isr load (full frame mode encodes in there)
+static void refreshWS2801(void){
+	uint32_t start = DWT_GetCycles();
+	WS2812_Refresh(WS2801_Slave_GetLastReceivedLedNumber());
+	refreshCycles += DWT_GetCycles() - start;
+}
+
+static void refreshAdalight(void){
+	uint32_t start = DWT_GetCycles();
+	WS2812_Refresh(Adalight_Slave_GetLastReceivedLedNumber());
+	refreshCycles += DWT_GetCycles() - start;
+}
+
+static void transferComplete(void){
+	framesSent++;
+	frameSent = 1;
+}
+
+static void PrintUint(uint32_t value){
+	char buf[11];
+	uint8_t pos = sizeof(buf) - 1;
+
+	buf[pos] = 0;
+	do{
+		buf[--pos] = '0' + (value % 10);
+		value /= 10;
+	}while(value != 0);
+
+	UART1_SendString(&buf[pos]);
+}
+
+static void SendFrame(tSource source, uint32_t numLeds, uint8_t pattern){
+	if(source == Source_WS2801){
+		for(uint32_t i = 0; i<3*numLeds; ++i){
+			WS2801_Slave_InjectByte((uint8_t)(i + pattern));
+		}
+		WS2801_Slave_InjectLatch();
+	}
+	else{
+		Adalight_Slave_InjectByte('A');
+		Adalight_Slave_InjectByte('d');
+		Adalight_Slave_InjectByte('a');
+		Adalight_Slave_InjectByte((uint8_t)(numLeds>>8));
+		Adalight_Slave_InjectByte((uint8_t)(numLeds));
+		Adalight_Slave_InjectByte(((uint8_t)(numLeds>>8)) ^ ((uint8_t)(numLeds)) ^ 0x55);
+		for(uint32_t i = 0; i<3*numLeds; ++i){
+			Adalight_Slave_InjectByte((uint8_t)(i + pattern));
+		}
+	}
+}
+
+// 1 if the entry fits into the framebuffer and hasn't been run yet (WS2812_MAX_LED_NUM can equal an entry)
+static uint8_t LedCountUsed(uint32_t i){
+	if(ledCounts[i] > WS2812_MAX_LED_NUM){
+		return 0;
+	}
+	for(uint32_t k = 0; k<i; ++k){
+		if(ledCounts[k] == ledCounts[i]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// spins until a frame has been sent or the timeout elapsed, returns the iterations
+static uint32_t IdleLoop(uint32_t timeout){
+	uint32_t iters = 0;
+	uint32_t start = DWT_GetCycles();
+
+	while((frameSent == 0) && (DWT_GetCycles() - start < timeout)){
+		iters++;
+	}
+	return iters;
+}
+
+// counts the idle loop iterations within one run without any load
+static void CalibrateIdleLoop(void){
+	frameSent = 0;
+	idleItersPerRun = IdleLoop(MEASURE_CYCLES);
+	frameSent = 1;
+}
+
+static void RunBenchmark(tSource source, uint32_t numLeds){
+	tCycleBudget const * refill = CycleBudget_Get(CycleBudget_WS2812_Refill);
+	tCycleBudget const * latch = CycleBudget_Get(CycleBudget_WS2812_Latch);
+	uint32_t idleIters = 0;
+	uint8_t pattern = 0;
+
+	while(frameSent == 0);
+	framesSent = 0;
+
+	uint32_t refillStart = refill->total;
+	uint32_t latchStart = latch->total;
+	uint32_t refreshStart = refreshCycles;
+	uint32_t callsStart = refill->calls;
+	uint32_t start = DWT_GetCycles();
+
+	while(DWT_GetCycles() - start < MEASURE_CYCLES){
+		idleIters += IdleLoop(MEASURE_CYCLES);
+		frameSent = 0;
+		SendFrame(source,numLeds,pattern++);
+	}
+	while(frameSent == 0);
+
+	uint32_t elapsed = DWT_GetCycles() - start;
+	uint32_t refillCycles = refill->total - refillStart;
+	uint32_t isrCycles = refillCycles + (latch->total - latchStart) + (refreshCycles - refreshStart);
+	uint32_t calls = refill->calls - callsStart;
+
+	uint32_t fps10 = (uint32_t)(((uint64_t)framesSent * 10 * SystemCoreClock) / elapsed);
+	uint32_t isrLoad = (uint32_t)(((uint64_t)isrCycles * 100) / elapsed);
+	uint32_t headroom = (uint32_t)(((uint64_t)idleIters * 100) / idleItersPerRun);
+
+	UART1_SendString(source == Source_WS2801 ? "ws2801   " : "adalight ");
+	UART1_SendString("leds=");
+	PrintUint(numLeds);
+	UART1_SendString(" fps=");
+	PrintUint(fps10/10);
+	UART1_SendChar('.');
+	PrintUint(fps10%10);
+	UART1_SendString(" isr=");
+	PrintUint(isrLoad);
+	UART1_SendString("% idle=");
+	PrintUint(headroom);
+	UART1_SendString("% refill_max=");
+	PrintUint(refill->max);
+	UART1_SendString("cyc latch_max=");
+	PrintUint(latch->max);
+	UART1_SendString("cyc per_led=");
+	PrintUint((calls != 0) ? refillCycles / (calls * WS2812_LEDS_PER_REFILL) : 0);
+	UART1_SendString("cyc\r\n");
+	UART1_Flush();
+}
+
+// cycles per led of WS2812_SetLed in a loop against the span functions
+static void SpanBenchmark(void){
+	static uint8_t rgb[3 * SPAN_LEDS];
+	tWS2812_RGB color = {1,2,3};
+
+	for(uint32_t i = 0; i<sizeof(rgb); ++i){
+		rgb[i] = (uint8_t)i;
+	}
+
+	uint32_t start = DWT_GetCycles();
+	for(uint32_t i = 0; i<SPAN_LEDS; ++i){
+		WS2812_SetLed(i,(tWS2812_RGB const *)&rgb[3*i]);
+	}
+	uint32_t setLed = DWT_GetCycles() - start;
+
+	start = DWT_GetCycles();
+	WS2812_WriteLeds(0,SPAN_LEDS,rgb);
+	uint32_t write = DWT_GetCycles() - start;
+
+	start = DWT_GetCycles();
+	WS2812_FillLeds(0,SPAN_LEDS,&color);
+	uint32_t fill = DWT_GetCycles() - start;
+
+	start = DWT_GetCycles();
+	WS2812_CopyLeds(SPAN_LEDS,0,SPAN_LEDS);
+	uint32_t copy = DWT_GetCycles() - start;
+
+	UART1_SendString("spans    leds=");
+	PrintUint(SPAN_LEDS);
+	UART1_SendString(" setled=");
+	PrintUint(setLed / SPAN_LEDS);
+	UART1_SendString(" write=");
+	PrintUint(write / SPAN_LEDS);
+	UART1_SendString(" fill=");
+	PrintUint(fill / SPAN_LEDS);
+	UART1_SendString(" copy=");
+	PrintUint(copy / SPAN_LEDS);
+	UART1_SendString("cyc/led\r\n");
+	UART1_Flush();
+}
+
+int main(void){
+
+	Systick_Init();
+	CycleBudget_Init();
+	UART1_init(UART1_BAUD_115200);
+
+	WS2812_Init();
+	WS2812_SetTransferCompleteCallback(transferComplete);
+
+	WS2801_Slave_SetColorReceivedCallback(setLedWS2801);
+	WS2801_Slave_SetFrameCompleteCallback(refreshWS2801);
+	Adalight_Slave_SetColorReceivedCallback(setLedAdalight);
+	Adalight_Slave_SetFrameCompleteCallback(refreshAdalight);
+
+	UART1_SendString("WS2812 benchmark, core clock ");
+	PrintUint(SystemCoreClock);
+	UART1_SendString("Hz, pixel format ");
+	PrintUint(WS2812_PIXEL_FORMAT);
+	UART1_SendString("\r\n");
+	UART1_Flush();
+
+	SpanBenchmark();
+	CalibrateIdleLoop();
+
+	for(uint32_t i = 0; i<sizeof(ledCounts)/sizeof(ledCounts[0]); ++i){
+		if(!LedCountUsed(i)){
+			continue;
+		}
+		RunBenchmark(Source_WS2801,ledCounts[i]);
+		RunBenchmark(Source_Adalight,ledCounts[i]);
+	}
+
+#if WS2812_SMOOTHING
+	// the same with the smoothing filter, the pattern changes every frame so it never settles
+	UART1_SendString("smoothing\r\n");
+	WS2812_SetSmoothing(192);
+	for(uint32_t i = 0; i<sizeof(ledCounts)/sizeof(ledCounts[0]); ++i){
+		if(!LedCountUsed(i)){
+			continue;
+		}
+		RunBenchmark(Source_WS2801,ledCounts[i]);
+	}
+	WS2812_SetSmoothing(0);
+#endif
+
+	// the same with the span callbacks instead of one call per led
+	UART1_SendString("span callbacks\r\n");
+	WS2801_Slave_SetColorReceivedCallback(0);
+	WS2801_Slave_SetSpanReceivedCallback(WS2812_WriteLeds);
+	Adalight_Slave_SetColorReceivedCallback(0);
+	Adalight_Slave_SetSpanReceivedCallback(WS2812_WriteLeds);
+	for(uint32_t i = 0; i<sizeof(ledCounts)/sizeof(ledCounts[0]); ++i){
+		if(!LedCountUsed(i)){
+			continue;
+		}
+		RunBenchmark(Source_WS2801,ledCounts[i]);
+		RunBenchmark(Source_Adalight,ledCounts[i]);
+	}
+
+	UART1_SendString("done\r\n");
+	UART1_Flush();
+
+	// halt an attached debugger if a handler exceeded its budget during the runs
+	if(CycleBudget_Exceeded() && (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk)){
+		__ASM volatile ("bkpt #0");
+	}
+
+	while(1){
+
+	}
+}
+
+#endif
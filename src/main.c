@@ -8,7 +8,8 @@
   ******************************************************************************
 */
 
-#include <string.h>
+#ifndef WS2812_BENCHMARK
+
 #include "stm32f10x.h"
 #include "ws2812.h"
 #include "stm32f10x_uart1.h"
@@ -17,14 +18,11 @@
 #include "stm32f10x_gpio.h"
 #include "ws2801_slave.h"
 
-// Callback function for setting the leds
-void setLed(uint32_t lednum, tWS2801_RGB color){
-	tWS2812_RGB rgb;
-	memcpy(&rgb,&color,sizeof(color));
-	WS2812_SetLed(lednum,&rgb);
-}
+#ifndef OUTPUT_LED_NUM
+#define OUTPUT_LED_NUM    (0)   /**< leds of the strip, the received leds get stretched to them (WS2812_SCALING), 0 ... as received */
+#endif
 
-// Callback function for refreshing the leds
+// Callback function for refreshing the leds (called in the EXTI4 isr, doesn't wait for the ws2812 output)
 void refresh(void){
 	uint32_t ledsToRefresh = WS2801_Slave_GetLastReceivedLedNumber();
 	WS2812_Refresh(ledsToRefresh);
@@ -35,12 +33,17 @@ int main(void){
 	Systick_Init();
 
 	WS2812_Init();
+#if WS2812_SCALING
+	WS2812_SetScaling(OUTPUT_LED_NUM,WS2812_SCALE_LINEAR);
+#endif
 
 	WS2801_Slave_Init();
-	WS2801_Slave_SetColorReceivedCallback(setLed);
+	WS2801_Slave_SetSpanReceivedCallback(WS2812_WriteLeds);
     WS2801_Slave_SetFrameCompleteCallback(refresh);
 
 	while(1){
 
 	}
 }
+
+#endif
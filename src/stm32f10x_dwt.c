@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    stm32f10x_dwt.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   DWT cycle counter and per handler cycle budget bookkeeping
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "stm32f10x_dwt.h"
+#include "ws2812.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static tCycleBudget budgets[CycleBudget_Num];
+
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief enables the DWT cycle counter
+  */
+void DWT_Init(void){
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/**
+  * @brief enables the cycle counter and resets all budgets to their defaults
+  */
+void CycleBudget_Init(void){
+    DWT_Init();
+
+    memset(budgets,0,sizeof(budgets));
+    budgets[CycleBudget_WS2812_Refill].budget = CYCLE_BUDGET_WS2812_REFILL * WS2812_LEDS_PER_REFILL;
+    budgets[CycleBudget_WS2812_Latch].budget = CYCLE_BUDGET_WS2812_LATCH;
+    budgets[CycleBudget_WS2801_Byte].budget = CYCLE_BUDGET_WS2801_BYTE;
+    budgets[CycleBudget_Adalight_Byte].budget = CYCLE_BUDGET_ADALIGHT_BYTE;
+}
+
+/**
+  * @brief records one measured call
+  * @param id: handler which got measured
+  * @param cycles: cycles the call took
+  */
+void CycleBudget_Add(tCycleBudgetId id, uint32_t cycles){
+    tCycleBudget *budget = &budgets[id];
+
+    budget->calls++;
+    budget->total += cycles;
+    if(cycles > budget->max){
+        budget->max = cycles;
+    }
+    if(cycles > budget->budget){
+        budget->overruns++;
+    }
+}
+
+/**
+  * @brief returns the statistics of the given handler
+  * @param id: handler
+  */
+tCycleBudget const * CycleBudget_Get(tCycleBudgetId id){
+    return &budgets[id];
+}
+
+/**
+  * @brief returns 1 if any handler has exceeded its budget, else 0
+  */
+uint8_t CycleBudget_Exceeded(void){
+    for(uint32_t i = 0; i<CycleBudget_Num; ++i){
+        if(budgets[i].overruns != 0){
+            return 1;
+        }
+    }
+    return 0;
+}
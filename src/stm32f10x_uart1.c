@@ -85,7 +85,7 @@ void UART1_init(uint32_t baud){
     USART1->CR1 |= USART_CR1_RE; //receiver enable
     
     NVIC_EnableIRQ(USART1_IRQn);
-    NVIC_SetPriority(USART1_IRQn,0);
+    NVIC_SetPriority(USART1_IRQn,1); // below the ws2812 refill dma
     
     USART1->CR1 |= USART_CR1_UE; // enables usart1
 }
@@ -120,6 +120,14 @@ void UART1_SendString(char const *str){
     }
 }
 
+/**
+  * @brief blocks until all buffered chars have been sent
+  */
+void UART1_Flush(void){
+    while(!Ringbuffer_IsEmpty(&txBufferStruct));
+    while((USART1->SR & USART_SR_TC) == 0);
+}
+
 /**
   * @brief sets a receiver function
   * @param ParserFunc: function pointer to call after interrupt
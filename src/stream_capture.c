@@ -0,0 +1,199 @@
+/**
+  ******************************************************************************
+  * @file    stream_capture.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Capture and replay of the raw WS2801 / Adalight input streams
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stream_capture.h"
+#include "stm32f10x_systick.h"
+#include "ws2801_slave.h"
+#include "adalight_slave.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define TAG_EVENT_POS       (6)
+#define TAG_DELTA_MASK      (0x3F)
+#define TAG_DELTA_EXT       (0x3F)   /**< 16 bit delta follows */
+#define MAX_RECORD_SIZE     (4)
+#define PARSER_TIMEOUT_MS   (11)     /**< parsers restart after 10ms silence */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static uint8_t *captureBuffer = 0;
+static uint32_t captureSize = 0;
+static uint32_t captureLength = 0;
+static uint32_t lastRecordMs = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief starts a new capture into the given buffer (stops when the buffer is full)
+  * @param buffer: buffer to record into
+  * @param size: size of the buffer in bytes
+  */
+void StreamCapture_Start(uint8_t *buffer, uint32_t size){
+    captureBuffer = 0;
+    if((buffer == 0) || (size < STREAM_CAPTURE_HEADER_SIZE)){
+        return;
+    }
+
+    buffer[0] = 'S';
+    buffer[1] = 'C';
+    buffer[2] = 'A';
+    buffer[3] = 'P';
+    buffer[4] = STREAM_CAPTURE_VERSION;
+    captureSize = size;
+    captureLength = STREAM_CAPTURE_HEADER_SIZE;
+    lastRecordMs = Systick_GetMillis();
+    captureBuffer = buffer;
+}
+
+/**
+  * @brief stops the current capture
+  * @returns number of bytes recorded (including the header)
+  */
+uint32_t StreamCapture_Stop(void){
+    captureBuffer = 0;
+    return captureLength;
+}
+
+/**
+  * @brief records one event (gets called from the isr's)
+  * @param event: event type
+  * @param data: received byte, ignored for latch events
+  */
+void StreamCapture_Record(tStreamEvent event, uint8_t data){
+    if((captureBuffer == 0) || (captureSize - captureLength < MAX_RECORD_SIZE)){
+        return;
+    }
+
+    uint32_t now = Systick_GetMillis();
+    uint32_t delta = now - lastRecordMs;
+    uint8_t *pos = captureBuffer + captureLength;
+    lastRecordMs = now;
+
+    if(delta < TAG_DELTA_EXT){
+        *pos++ = (uint8_t)((event << TAG_EVENT_POS) | delta);
+    }
+    else{
+        if(delta > 0xFFFF){
+            delta = 0xFFFF;
+        }
+        *pos++ = (uint8_t)((event << TAG_EVENT_POS) | TAG_DELTA_EXT);
+        *pos++ = (uint8_t)(delta >> 8);
+        *pos++ = (uint8_t)(delta);
+    }
+
+    if(event != StreamEvent_WS2801_Latch){
+        *pos++ = data;
+    }
+
+    captureLength = pos - captureBuffer;
+}
+
+/**
+  * @brief initializes a reader on the given capture
+  * @param reader: reader to initialize
+  * @param capture: capture including header
+  * @param length: length of the capture in bytes
+  * @returns 1 if the header is valid, else 0
+  */
+uint8_t StreamCapture_ReaderInit(tStreamReader *reader, uint8_t const *capture, uint32_t length){
+    reader->pos = capture;
+    reader->end = capture;
+
+    if((length < STREAM_CAPTURE_HEADER_SIZE) || (capture[0] != 'S') || (capture[1] != 'C') ||
+       (capture[2] != 'A') || (capture[3] != 'P') || (capture[4] != STREAM_CAPTURE_VERSION)){
+        return 0;
+    }
+
+    reader->pos = capture + STREAM_CAPTURE_HEADER_SIZE;
+    reader->end = capture + length;
+    return 1;
+}
+
+/**
+  * @brief decodes the next record
+  * @param reader: reader to operate
+  * @param record: decoded record
+  * @returns 1 if a record has been decoded, 0 at the end of the capture
+  */
+uint8_t StreamCapture_Next(tStreamReader *reader, tStreamRecord *record){
+    uint8_t const *pos = reader->pos;
+
+    if(pos >= reader->end){
+        return 0;
+    }
+
+    uint8_t tag = *pos++;
+    record->event = (tStreamEvent)(tag >> TAG_EVENT_POS);
+    record->delta = tag & TAG_DELTA_MASK;
+    record->data = 0;
+
+    if(record->delta == TAG_DELTA_EXT){
+        if(reader->end - pos < 2){
+            reader->pos = reader->end;
+            return 0;
+        }
+        record->delta = (uint16_t)((pos[0] << 8) | pos[1]);
+        pos += 2;
+    }
+
+    if(record->event != StreamEvent_WS2801_Latch){
+        if(pos >= reader->end){
+            reader->pos = reader->end;
+            return 0;
+        }
+        record->data = *pos++;
+    }
+
+    reader->pos = pos;
+    return 1;
+}
+
+/**
+  * @brief feeds the capture through the parsers of the WS2801 and Adalight slave
+  * @param capture: capture including header
+  * @param length: length of the capture in bytes
+  * @param speed: replay speed
+  * @returns number of replayed records
+  */
+uint32_t StreamCapture_Replay(uint8_t const *capture, uint32_t length, tStreamReplaySpeed speed){
+    tStreamReader reader;
+    tStreamRecord record;
+    uint32_t replayed = 0;
+
+    if(StreamCapture_ReaderInit(&reader,capture,length) == 0){
+        return 0;
+    }
+
+    while(StreamCapture_Next(&reader,&record)){
+        uint32_t wait = record.delta;
+
+        // the parsers only see gaps which restart them, all others get dropped
+        if(speed == StreamReplay_Maximum){
+            wait = (wait < PARSER_TIMEOUT_MS) ? 0 : PARSER_TIMEOUT_MS;
+        }
+
+        if(wait != 0){
+            uint32_t start = Systick_GetMillis();
+            while(Systick_GetMillis() - start <= wait);
+        }
+
+        switch(record.event){
+            case StreamEvent_WS2801_Byte:   WS2801_Slave_InjectByte(record.data); break;
+            case StreamEvent_WS2801_Latch:  WS2801_Slave_InjectLatch(); break;
+            case StreamEvent_Adalight_Byte: Adalight_Slave_InjectByte(record.data); break;
+            default: break;
+        }
+        replayed++;
+    }
+
+    return replayed;
+}
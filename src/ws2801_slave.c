@@ -20,13 +20,20 @@
 
 #include "ws2801_slave.h"
 #include "stm32f10x_systick.h"
+#include "stm32f10x_dwt.h"
+#include "stream_capture.h"
 
 static void (*colorCompleteCb)(uint32_t ledNum, tWS2801_RGB color) = 0;
 static void (*frameCompleteCb)(void) = 0;
+static void (*spanReceivedCb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb) = 0;
 static uint32_t lednum = 0;
 static uint8_t cnt = 0;
 static uint8_t frameComplete = 0;
 static uint32_t receivedLedNum = 0;
+static uint8_t  spanData[3 * WS2801_SLAVE_SPAN_LEDS];   /**< r, g, b of the leds received since the last span */
+static uint32_t spanLeds = 0;
+
+static void Flush_Span(void);
 
 
 void WS2801_Slave_Init(void){
@@ -60,6 +67,8 @@ void WS2801_Slave_Init(void){
 	spiInt.NVIC_IRQChannelPreemptionPriority = 0;
 	spiInt.NVIC_IRQChannelSubPriority = 0;
 	NVIC_Init(&spiInt);
+	// below the ws2812 refill dma and latch timer, which send the frame a callback refreshed
+	NVIC_SetPriority(SPI1_IRQn,1);
 
 	//enable external interrupt on rising flag of nss (for frame complete detection)
 	EXTI_InitTypeDef nssInt;
@@ -70,6 +79,7 @@ void WS2801_Slave_Init(void){
 	EXTI_Init(&nssInt);
 	AFIO->EXTICR[2] |= AFIO_EXTICR2_EXTI4_PA;
 
+	NVIC_SetPriority(EXTI4_IRQn,1);
 	NVIC_EnableIRQ(EXTI4_IRQn);
 
 	SPI_Cmd(SPI1,ENABLE);
@@ -81,6 +91,9 @@ void WS2801_Slave_SetColorReceivedCallback(void (*cb)(uint32_t ledNum, tWS2801_R
 void WS2801_Slave_SetFrameCompleteCallback(void(*cb)(void)){
 	frameCompleteCb = cb;
 }
+void WS2801_Slave_SetSpanReceivedCallback(void (*cb)(uint32_t firstLed, uint32_t numLeds, uint8_t const * rgb)){
+	spanReceivedCb = cb;
+}
 
 uint8_t WS2801_Slave_FrameComplete(void){
 	NVIC_DisableIRQ(EXTI4_IRQn);
@@ -104,6 +117,7 @@ static void Spi_Handler(uint8_t ch){
 	if(now-last>10){
 		lednum = 0;
 		cnt = 0;
+		spanLeds = 0;
 		memset(&color,0,sizeof(tWS2801_RGB));
 	}
 
@@ -121,17 +135,58 @@ static void Spi_Handler(uint8_t ch){
 		if(colorCompleteCb != 0){
 			colorCompleteCb(lednum,color);
 		}
+		if(spanReceivedCb != 0){
+			uint8_t *rgb = &spanData[3 * spanLeds++];
+			rgb[0] = color.r;
+			rgb[1] = color.g;
+			rgb[2] = color.b;
+		}
 		memset(&color,0,sizeof(tWS2801_RGB));
 		lednum++;
+
+		if(spanLeds == WS2801_SLAVE_SPAN_LEDS){
+			Flush_Span();
+		}
 	}
 
 	last = now;
 }
 
+// hands the collected leds to the span callback
+static void Flush_Span(void){
+	if(spanLeds != 0 && spanReceivedCb != 0){
+		spanReceivedCb(lednum - spanLeds,spanLeds,spanData);
+	}
+	spanLeds = 0;
+}
+
+static void Nss_Handler(void){
+	Flush_Span();
+	frameComplete = 1;
+	cnt = 0;
+	receivedLedNum = lednum;
+	lednum = 0;
+
+	if(frameCompleteCb != 0){
+		frameCompleteCb();
+	}
+}
+
+void WS2801_Slave_InjectByte(uint8_t ch){
+	Spi_Handler(ch);
+}
+
+void WS2801_Slave_InjectLatch(void){
+	Nss_Handler();
+}
+
 void SPI1_IRQHandler(void){
 	if(SPI_I2S_GetITStatus(SPI1,SPI_I2S_IT_RXNE)){
 		uint8_t recv = SPI1->DR;
+		STREAM_CAPTURE_RECORD(StreamEvent_WS2801_Byte,recv);
+		CYCLE_BUDGET_BEGIN();
 		Spi_Handler(recv);
+		CYCLE_BUDGET_END(CycleBudget_WS2801_Byte);
 		SPI_I2S_ClearITPendingBit(SPI1,SPI_I2S_IT_RXNE);
 	}
 }
@@ -139,13 +194,7 @@ void SPI1_IRQHandler(void){
 void EXTI4_IRQHandler(void){
 	if(EXTI_GetITStatus(EXTI_Line4)){
 		EXTI_ClearITPendingBit(EXTI_Line4);
-		frameComplete = 1;
-		cnt = 0;
-		receivedLedNum = lednum;
-		lednum = 0;
-
-		if(frameCompleteCb != 0){
-			frameCompleteCb();
-		}
+		STREAM_CAPTURE_RECORD(StreamEvent_WS2801_Latch,0);
+		Nss_Handler();
 	}
 }
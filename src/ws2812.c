@@ -8,7 +8,7 @@
   *
   * This lib uses a double buffering method with cyclic reload of the
   * DMA to keep the RAM usage at a minimum level
-  * Used Peripherals:  DMA1, TIM4 with output capture compare (PWM)
+  * Used Peripherals:  DMA1, TIM4 with output capture compare (PWM) or SPI2, TIM3 (latch gap)
   *
   ******************************************************************************
 */
@@ -18,95 +18,864 @@
 #include <stm32f10x_tim.h>
 #include <stm32f10x_rcc.h>
 #include <stm32f10x_gpio.h>
+#include <stm32f10x_spi.h>
+#include <stm32f10x_crc.h>
 #include <string.h>
 #include "ws2812.h"
+#include "stm32f10x_dwt.h"
 
 
-#define MAX_LED_NUM        (1000)  /**< maximum number of leds */
-#define BYTE_PER_LED       (24)
+#define MAX_LED_NUM        (WS2812_MAX_LED_NUM)
 
-#define WS2812_T1H         (57)
-#define WS2812_T0H         (34)
-#define RESET_PULSE_T      (60)    // in microsec
-#define RESET_PULSE_CNTS   ((((RESET_PULSE_T*1.0)/(1.25))/BYTE_PER_LED)  )
+#ifndef WS2812_WAIT
+#define WS2812_WAIT()      /**< body of the loops waiting for the output, the host simulator runs its peripherals in it */
+#endif
 
+/* position of each color on the wire, the framebuffer is stored in this order */
+#if WS2812_RGBW
+#define CHANNELS           (4)
+#else
+#define CHANNELS           (3)
+#endif
+#define BITS_PER_LED       (8 * CHANNELS)
+#define WIRE_R             ((WS2812_COLOR_ORDER) & 0x3)
+#define WIRE_G             (((WS2812_COLOR_ORDER) >> 2) & 0x3)
+#define WIRE_B             (((WS2812_COLOR_ORDER) >> 4) & 0x3)
+#define WIRE_W             (((WS2812_COLOR_ORDER) >> 6) & 0x3)
 
-typedef tWS2812_RGB tRGB_Buffer[MAX_LED_NUM];
+#if (WIRE_R >= CHANNELS) || (WIRE_G >= CHANNELS) || (WIRE_B >= CHANNELS) || \
+    (WIRE_R == WIRE_G) || (WIRE_R == WIRE_B) || (WIRE_G == WIRE_B)
+#error "ws2812: invalid WS2812_COLOR_ORDER"
+#endif
+#if WS2812_RGBW && ((WIRE_W == WIRE_R) || (WIRE_W == WIRE_G) || (WIRE_W == WIRE_B))
+#error "ws2812: invalid WS2812_COLOR_ORDER, the white channel overlaps a color"
+#endif
 
-static tRGB_Buffer rgbBuffer[2];
+/* timing profiles in ns: nominal bit, T1H and T0H, the datasheet windows of the
+ * bit period, T1H, T0H, T1L and T0L (min, max) and the minimum reset time */
+#define PROFILE_WS2812       (1250, 790, 470,   650, 1850,   550,  850,   200, 500,   450,  750,   650,  950,   50000)
+#define PROFILE_WS2812B      (1250, 790, 470,   650, 1850,   650,  950,   250, 550,   300,  600,   700, 1000,   50000)
+#define PROFILE_SK6812       (1250, 600, 300,   650, 1850,   450,  750,   150, 450,   450,  750,   750, 1050,   80000)
+#define PROFILE_WS2811       (2500,1200, 500,  1900, 3100,  1050, 1350,   350, 650,  1150, 1450,  1850, 2150,   50000)
+#define PROFILE_WS2813       (1250, 900, 300,   650, 1850,   580, 1000,   220, 380,   220,  420,   580, 1000,  280000)
+#define PROFILE_WS2812B_FAST ( 975, 670, 270,   650, 1850,   650,  950,   250, 550,   300,  600,   700, 1000,   50000)
+
+#define UNPACK(...)          __VA_ARGS__
+#define EXPAND_CALL(m,args)  m args
+
+#define NS_TO_TICKS(ns,khz)  ((((ns) * (khz)) + 500000) / 1000000)
+#define TICKS_TO_NS(t,khz)   (((t) * 1000000) / (khz))
+#define IN_SPEC(t,khz,min,max) ((TICKS_TO_NS(t,khz) >= (min)) && (TICKS_TO_NS(t,khz) <= (max)))
+
+/* 1 if the profile quantized to the timer clock is within the datasheet windows and fits into the dma buffer */
+#define TIMING_OK_(khz,bit,t1h,t0h,bitMin,bitMax,t1hMin,t1hMax,t0hMin,t0hMax,t1lMin,t1lMax,t0lMin,t0lMax,reset) \
+	(IN_SPEC(NS_TO_TICKS(bit,khz),khz,bitMin,bitMax) && \
+	 IN_SPEC(NS_TO_TICKS(t1h,khz),khz,t1hMin,t1hMax) && \
+	 IN_SPEC(NS_TO_TICKS(t0h,khz),khz,t0hMin,t0hMax) && \
+	 IN_SPEC(NS_TO_TICKS(bit,khz) - NS_TO_TICKS(t1h,khz),khz,t1lMin,t1lMax) && \
+	 IN_SPEC(NS_TO_TICKS(bit,khz) - NS_TO_TICKS(t0h,khz),khz,t0lMin,t0lMax) && \
+	 (NS_TO_TICKS(t1h,khz) <= 255) && (NS_TO_TICKS(bit,khz) <= 0x10000))
+#define TIMING_OK(khz,profile) EXPAND_CALL(TIMING_OK_,(khz,UNPACK profile))
+
+#if WS2812_LED_TYPE == WS2812_TYPE_WS2812
+#define DEFAULT_PROFILE      PROFILE_WS2812
+#elif WS2812_LED_TYPE == WS2812_TYPE_WS2812B
+#define DEFAULT_PROFILE      PROFILE_WS2812B
+#elif WS2812_LED_TYPE == WS2812_TYPE_SK6812
+#define DEFAULT_PROFILE      PROFILE_SK6812
+#elif WS2812_LED_TYPE == WS2812_TYPE_WS2811
+#define DEFAULT_PROFILE      PROFILE_WS2811
+#elif WS2812_LED_TYPE == WS2812_TYPE_WS2813
+#define DEFAULT_PROFILE      PROFILE_WS2813
+#elif WS2812_LED_TYPE == WS2812_TYPE_WS2812B_FAST
+#define DEFAULT_PROFILE      PROFILE_WS2812B_FAST
+#else
+#error "ws2812: unknown WS2812_LED_TYPE"
+#endif
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+/* each bit as 3 spi bits: 100 ... 0, 110 ... 1 */
+#define SPI_BITS_PER_BIT     (3)
+#define SPI_CLOCK_KHZ        (WS2812_TIM_CLOCK_KHZ / 2)   /**< PCLK1, the timer clock is doubled */
+#define SPI_DEFAULT_PRESCALER (4)                         /**< PCLK1 / 16, 2.25MHz at 36MHz */
+
+#define SPI_TIMING_OK_(khz,bit,t1h,t0h,bitMin,bitMax,t1hMin,t1hMax,t0hMin,t0hMax,t1lMin,t1lMax,t0lMin,t0lMax,reset) \
+	(IN_SPEC(3,khz,bitMin,bitMax) && IN_SPEC(2,khz,t1hMin,t1hMax) && IN_SPEC(1,khz,t0hMin,t0hMax) && \
+	 IN_SPEC(1,khz,t1lMin,t1lMax) && IN_SPEC(2,khz,t0lMin,t0lMax))
+#define SPI_TIMING_OK(khz,profile) EXPAND_CALL(SPI_TIMING_OK_,(khz,UNPACK profile))
+
+/* check that one of the spi prescalers meets the default profile */
+#if !(SPI_TIMING_OK(SPI_CLOCK_KHZ / 2,DEFAULT_PROFILE)  || SPI_TIMING_OK(SPI_CLOCK_KHZ / 4,DEFAULT_PROFILE)  || \
+      SPI_TIMING_OK(SPI_CLOCK_KHZ / 8,DEFAULT_PROFILE)  || SPI_TIMING_OK(SPI_CLOCK_KHZ / 16,DEFAULT_PROFILE) || \
+      SPI_TIMING_OK(SPI_CLOCK_KHZ / 32,DEFAULT_PROFILE) || SPI_TIMING_OK(SPI_CLOCK_KHZ / 64,DEFAULT_PROFILE) || \
+      SPI_TIMING_OK(SPI_CLOCK_KHZ / 128,DEFAULT_PROFILE)|| SPI_TIMING_OK(SPI_CLOCK_KHZ / 256,DEFAULT_PROFILE))
+#error "ws2812: WS2812_LED_TYPE can't be met with the spi backend at WS2812_TIM_CLOCK_KHZ"
+#endif
+
+#define DMA_BYTE_PER_LED     (BITS_PER_LED * SPI_BITS_PER_BIT / 8)
+#define LATCH_LAG_BITS       (6)     /**< data register + shift register: 16 spi bits behind the dma */
+#define WS2812_DMA           DMA1_Channel5
+#define WS2812_DMA_IRQn      DMA1_Channel5_IRQn
+#define WS2812_DMA_IT_HT     DMA1_IT_HT5
+#define WS2812_DMA_IT_TC     DMA1_IT_TC5
+#define WS2812_DMA_IRQHandler DMA1_Channel5_IRQHandler
+#else
+/* check the quantized waveform of the default profile against the datasheet */
+#if !TIMING_OK(WS2812_TIM_CLOCK_KHZ,DEFAULT_PROFILE)
+#error "ws2812: WS2812_LED_TYPE out of spec at WS2812_TIM_CLOCK_KHZ"
+#endif
+
+#define DMA_BYTE_PER_LED     (BITS_PER_LED)   /**< one duty cycle per bit */
+#define LATCH_LAG_BITS       (2)     /**< preloaded compare value + the bit on the line */
+#define WS2812_DMA           DMA1_Channel1
+#define WS2812_DMA_IRQn      DMA1_Channel1_IRQn
+#define WS2812_DMA_IT_HT     DMA1_IT_HT1
+#define WS2812_DMA_IT_TC     DMA1_IT_TC1
+#define WS2812_DMA_IRQHandler DMA1_Channel1_IRQHandler
+#endif
+
+#define LEDS_PER_HALF        (WS2812_LEDS_PER_REFILL)
+#define HALF_BITS            (LEDS_PER_HALF * BITS_PER_LED)   /**< led bits in one half of the dma buffer */
+
+#if (HALF_BITS + LATCH_LAG_BITS + 2) >= (2 * HALF_BITS)
+#error "ws2812: dma buffer half too short to stop the output in the latch"
+#endif
+
+#if WS2812_FULL_FRAME
+#define DMA_BUFFER_SIZE      (MAX_LED_NUM * DMA_BYTE_PER_LED + 1)   /**< whole frame + a zero for the latch */
+#else
+#define DMA_BUFFER_SIZE      (2 * LEDS_PER_HALF * DMA_BYTE_PER_LED)
+#endif
+
+typedef struct{
+	uint16_t bit, t1h, t0h;
+	uint16_t bitMin, bitMax, t1hMin, t1hMax, t0hMin, t0hMax, t1lMin, t1lMax, t0lMin, t0lMax;
+	uint32_t reset;
+}tTimingProfile;
+
+static tTimingProfile const timingProfiles[] = {
+	[WS2812_TYPE_WS2812]      = {EXPAND_CALL(UNPACK,PROFILE_WS2812)},
+	[WS2812_TYPE_WS2812B]     = {EXPAND_CALL(UNPACK,PROFILE_WS2812B)},
+	[WS2812_TYPE_SK6812]      = {EXPAND_CALL(UNPACK,PROFILE_SK6812)},
+	[WS2812_TYPE_WS2811]      = {EXPAND_CALL(UNPACK,PROFILE_WS2811)},
+	[WS2812_TYPE_WS2813]      = {EXPAND_CALL(UNPACK,PROFILE_WS2813)},
+	[WS2812_TYPE_WS2812B_FAST]= {EXPAND_CALL(UNPACK,PROFILE_WS2812B_FAST)},
+};
+
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+typedef struct{ uint16_t c[CHANNELS]; }tPixel;   /**< channels in wire order */
+#define REPEAT_FRAMES      (1)     /**< keep dithering while no new frame arrives */
+#define TO_PIXEL(v)        ((uint16_t)((v) * 257))
+#define TO_PIXEL16(v)      (v)
+#define FROM_PIXEL(v)      ((uint8_t)((v) >> 8))
+#define FROM_PIXEL16(v)    (v)
+#define TO_SMOOTH(v)       (v)
+#define FROM_SMOOTH(v)     (v)
+#define PIXEL_MAX          (0xFFFF)
+#else
+typedef struct{ uint8_t c[CHANNELS]; }tPixel;    /**< channels in wire order */
+#define REPEAT_FRAMES      (WS2812_INTERPOLATION)     /**< keep crossfading while no new frame arrives */
+#define TO_PIXEL(v)        (v)
+#define TO_PIXEL16(v)      ((uint8_t)(((v) + 0x80 - ((v) >> 8)) >> 8))
+#define FROM_PIXEL(v)      (v)
+#define FROM_PIXEL16(v)    ((uint16_t)((v) * 257))
+#define TO_SMOOTH(v)       ((uint16_t)((v) << 8))              /**< 8.8 fixed point filter state */
+#define FROM_SMOOTH(v)     ((uint8_t)(((v) + 0x80) >> 8))
+#define PIXEL_MAX          (0xFF)
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+typedef uint8_t tFramePixel;                      /**< palette index, resolved while encoding */
+#define TO_STORED(r,g,b)   ((uint8_t)(((r) & 0xE0) | (((g) >> 3) & 0x1C) | ((b) >> 6)))   /**< rgb 3-3-2 */
+#define COMPACT_FORMAT     (1)
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+typedef uint16_t tFramePixel;                     /**< rgb 5-6-5, expanded while encoding */
+#define TO_STORED(r,g,b)   ((uint16_t)((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3)))
+#define COMPACT_FORMAT     (1)
+#else
+typedef tPixel tFramePixel;
+#define COMPACT_FORMAT     (0)     /**< the framebuffer holds the pixels in wire order */
+#endif
+
+#if WS2812_FULL_FRAME && (REPEAT_FRAMES || WS2812_SMOOTHING)
+#error "ws2812: WS2812_FULL_FRAME can't dither, interpolate or smooth, every frame would get encoded in the isr"
+#endif
+
+#define DITHER_SPREAD      (0x9D)  /**< odd offset between neighbour leds, decorrelates the dither */
+
+#if WS2812_RLE
+#define RLE_LITERAL        (0x8000)    /**< run count flag: the run holds one color per led */
+#define RLE_MAX_COUNT      (0x7FFF)
+
+typedef struct{
+	uint16_t    counts[WS2812_RLE_RUNS];     /**< leds per run, with RLE_LITERAL for a literal run */
+	tFramePixel colors[WS2812_RLE_COLORS];   /**< in run order, one per fill run, one per led of a literal run */
+	uint32_t    runs;                        /**< runs in use */
+	uint32_t    used;                        /**< colors in use */
+	uint32_t    leds;                        /**< leds of the runs, the leds above hold the value 0 */
+}tRGB_Buffer;
+#else
+typedef tFramePixel tRGB_Buffer[MAX_LED_NUM];
+#endif
+
+#define POWER_SUMS         (WS2812_POWER_LIMIT && !WS2812_RLE)   /**< the set functions keep the sums up to date */
+
+#if POWER_SUMS
+#define POWER_REMOVE(p)    Power_AccountSpan((p),1,-1)
+#define POWER_ADD(p)       Power_AccountSpan((p),1,1)
+#define POWER_REMOVE_SPAN(p,n) Power_AccountSpan((p),(n),-1)
+#define POWER_ADD_SPAN(p,n)    Power_AccountSpan((p),(n),1)
+#else
+#define POWER_REMOVE(p)
+#define POWER_ADD(p)
+#define POWER_REMOVE_SPAN(p,n)
+#define POWER_ADD_SPAN(p,n)
+#endif
+
+// the framebuffer holds the bytes of WS2812_WriteLeds as they are
+#define SPAN_COPY          ((WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB888) && !WS2812_RGBW && \
+                            (WIRE_R == 0) && (WIRE_G == 1) && (WIRE_B == 2))
+// 3 byte pixels, the span functions move 4 leds as 3 words once the pixel is word aligned
+#define SPAN_WORDS         ((WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB888) && !WS2812_RGBW && !WS2812_RLE)
+
+#if SPAN_WORDS
+// rgb byte of the byte n of 4 leds in wire order, the words are little endian
+#define WIRE_SOURCE(n)     (((n) / 3) * 3 + ((((n) % 3) == WIRE_R) ? 0 : (((n) % 3) == WIRE_G) ? 1 : 2))
+#define WIRE_BYTE(in,n)    ((((in)[WIRE_SOURCE(n) / 4] >> (8 * (WIRE_SOURCE(n) % 4))) & 0xFF) << (8 * ((n) % 4)))
+#define WIRE_WORD(in,w)    (WIRE_BYTE(in,4 * (w)) | WIRE_BYTE(in,4 * (w) + 1) | \
+                            WIRE_BYTE(in,4 * (w) + 2) | WIRE_BYTE(in,4 * (w) + 3))
+#endif
+
+#if WS2812_SINGLE_BUFFER && WS2812_INTERPOLATION
+#error "ws2812: WS2812_SINGLE_BUFFER can't interpolate, the crossfade needs the previous frame"
+#endif
+
+#if WS2812_RLE && (WS2812_REMAP || WS2812_SCALING || WS2812_INTERPOLATION || WS2812_SMOOTHING || WS2812_SINGLE_BUFFER)
+#error "ws2812: WS2812_RLE can't remap, scale, interpolate, smooth or write into the frame on the wire, the encoder decodes the runs in order"
+#endif
+
+#if WS2812_RLE
+// back buffer pixel of the non compact set functions, gets appended to the runs afterwards
+#define BACK_PIXEL(lednum)     (&(tPixel){{0}})
+#define STORE_PIXEL(lednum,p)  Store_Led((lednum),*(p))
+#else
+#define BACK_PIXEL(lednum)     (&rgbBuffer[nextRGBIdx][(lednum)])
+#define STORE_PIXEL(lednum,p)
+#endif
+
+#if WS2812_INTERPOLATION
+#define FRAME_BUFFERS      (3)     /**< the previous frame is kept for the crossfade */
+#elif WS2812_SINGLE_BUFFER
+#define FRAME_BUFFERS      (1)     /**< the set functions write into the frame on the wire */
+#else
+#define FRAME_BUFFERS      (2)
+#endif
+
+static tRGB_Buffer rgbBuffer[FRAME_BUFFERS];
 static uint8_t     currentRGBIdx = 0;
-static uint8_t     nextRGBIdx    = 1;
-static uint8_t     dmaBuffer[2*BYTE_PER_LED];
+static uint8_t     nextRGBIdx    = (FRAME_BUFFERS > 1) ? 1 : 0;
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+static tPixel      palette[FRAME_BUFFERS][256];   /**< belongs to the framebuffer with the same index */
+#endif
+#if WS2812_RLE
+static tFramePixel const rleBlank;       /**< value of the leds above the runs */
+static uint32_t    rleDrops = 0;
+
+// the encoder reads the leds of the frame on the wire in order, each led continues where the one before ended
+static uint32_t    rleLed = 0;            /**< next led */
+static uint32_t    rleRun = 0;            /**< its run */
+static uint32_t    rleLeft = 0;           /**< leds left in the run, 0 ... the run starts */
+static uint32_t    rleColor = 0;          /**< its color */
+#endif
+#if WS2812_INTERPOLATION
+static uint8_t     previousRGBIdx = 2;
+
+// crossfade: each frame moves blendPos by blendStep from the previous (0) to the current frame (256)
+static uint16_t blendPos = 256;
+static uint16_t blendStep = 256;
+static uint32_t outputFrames = 0;         /**< frames sent since the last refresh */
+static uint32_t framesPerInput = 256;     /**< averaged frames per refresh, 8.8 fixed point */
+#define MAX_BLEND_FRAMES   (255)          /**< longest crossfade, long pauses don't count */
+#define BLEND_SHARE        (192)          /**< part of the interval the fade takes (/256), done before early frames */
+#endif
+static uint8_t     dmaBuffer[DMA_BUFFER_SIZE];
+static uint32_t    dmaTransferSize = DMA_BUFFER_SIZE;
 
 static uint32_t currentLEDIdx = 0;
 static uint32_t lednumToTransmit= 0;
+static uint32_t lednumInput = 0;    /**< framebuffer leds of the frame, the others get sent dark */
 
-static uint32_t resetPulseIdx = 0;
-static uint8_t sendResetPulse = 0;
-static uint8_t const cResetPulseValue = 0;
+#if WS2812_SMOOTHING
+// smoothing: every frame moves the filter state of each output led towards its pixel
+static uint16_t smoothState[MAX_LED_NUM][CHANNELS];   /**< per output led in wire order, leds above pass unfiltered */
+static uint16_t smoothGain = 256;                     /**< part of the distance moved per frame, 256 ... off */
+static volatile uint8_t smoothingMoved = 0;           /**< the frame changed a state, send it again */
+#define SMOOTHING_MOVED    (smoothingMoved)
+#else
+#define SMOOTHING_MOVED    (0)
+#endif
+
+#if WS2812_FULL_FRAME
+#define MAX_OUTPUT_LEDS    (MAX_LED_NUM)     /**< the whole frame has to fit into the dma buffer */
+#else
+#define MAX_OUTPUT_LEDS    (0xFFFF)
+#endif
+
+#if WS2812_REMAP || WS2812_SCALING
+static tPixel const darkPixel;
+#endif
+
+#if WS2812_SCALING
+// scaling: the refreshed leds get stretched to scaleLength leds while encoding
+static uint32_t scaleLength = 0;    /**< leds of the scaled strip, 0 ... off */
+static uint8_t  scaleMode = WS2812_SCALE_LINEAR;
+static uint32_t scaleStep = 0;      /**< framebuffer leds per scaled led in 16.16 fixed point */
+static uint32_t scaleOffset = 0;
+#define MAX_REMAP_LED      (MAX_OUTPUT_LEDS) /**< the remap points into the scaled strip */
+#else
+#define MAX_REMAP_LED      (MAX_LED_NUM)
+#endif
+
+#if WS2812_REMAP
+// remap: output led -> framebuffer (or scaled) led, from a table or a run list (read while encoding)
+static uint16_t const    *remapTable = 0;
+static tWS2812_Run const *remapRuns = 0;
+static uint32_t remapLength = 0;    /**< output leds of the remap, 0 ... off */
+static uint32_t runIdx = 0;         /**< run list cursor, advanced led by led */
+static uint32_t runLeft = 0;
+static uint32_t runRepeat = 0;
+static int32_t  runLed = 0;
+#endif
+
+#if WS2812_BACKEND == WS2812_BACKEND_PWM
+// waveform in timer ticks, calculated from the selected profile and the timer clock
+static uint16_t timReload = 0;
+static uint8_t  dutyT0H = 0;
+static uint8_t  dutyDiff = 0;
+#endif
+static uint32_t bitNs = 0;
+static uint32_t resetNs = 0;
+
+// latch: the dma streams the zeros after the last led until TIM3 stops it and times the gap
+static uint32_t tailBits = 0;       /**< led bits in the half before the zeros */
+static volatile uint8_t tailStarted = 0;
+static volatile uint8_t gapActive = 0;
+static volatile uint8_t frameArmed = 0;
+
+#if WS2812_POWER_LIMIT
+#if POWER_SUMS
+// power limit: channel sums of the back buffer leds below powerLeds, kept up to date by the set functions
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+static uint16_t paletteCount[256];          /**< leds per palette entry, the palette can change */
+#else
+static uint32_t powerSums[CHANNELS];
+#endif
+static uint8_t  powerRecount = 0;           /**< the back buffer has been handed out, the sums are unknown */
+static uint32_t powerLeds = 0;              /**< leds in the sums, the count of the last refresh */
+#endif
+static uint16_t powerUa[CHANNELS];          /**< current per channel at full scale in uA, in wire order */
+static uint16_t powerIdleUa = 0;
+static uint32_t powerBudgetMa = 0;          /**< 0 ... no limit */
+static uint32_t powerEstimateMa = 0;
+static uint16_t powerScale = 256;           /**< applied through the correction table, 256 ... unlimited */
+#endif
+
+#if WS2812_DEDUP
+// duplicate detection: crc of the led count and the pixels of the last sent frame
+static uint32_t lastFrameCrc = 0;
+static uint8_t  lastFrameValid = 0;
+static tWS2812_DedupStats dedupStats;
+#endif
+
+#if WS2812_SINGLE_BUFFER
+static volatile uint32_t tearCount = 0;
+#define TEAR_CHECK(first,numLeds)  Check_Tear((first),(numLeds))
+#else
+#define TEAR_CHECK(first,numLeds)
+#endif
 
 static uint8_t transferComplete = 1;
+static volatile uint8_t frameFresh = 0;    /**< the frame hasn't been sent completely yet */
+static volatile uint8_t transferRunning = 0;
+static volatile uint8_t refreshRequested = 0;
+static volatile uint8_t refreshPending = 0;  /**< a refresh came in during a transfer, the latch isr sends it next */
+static uint32_t pendingLeds = 0;
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+static uint8_t frameCounter = 0;
+static uint8_t ditherBase = 0;
+#endif
 static void (*transferCompleteCb)(void) = 0;
 
+// color correction, the encoder uses correctionLut[activeLut], the other one gets rebuilt
+static uint8_t  correctionLut[2][CHANNELS][257];  /**< per wire channel, last entry repeated for the interpolation */
+static uint16_t gammaCurve[256];                 /**< gamma curve in 8.8 fixed point */
+static volatile uint8_t activeLut = 0;
+static volatile uint8_t lutPending = 0;
+static volatile uint8_t lutBuilding = 0;
+static volatile uint8_t lutRebuild = 0;    /**< the values changed during the build, it starts over */
+static uint16_t gammaValue = 100;
+static uint8_t  brightness = 255;
+#if WS2812_RGBW
+static uint8_t  whiteBalance[CHANNELS] = {255,255,255,255};   /**< in wire order */
+#else
+static uint8_t  whiteBalance[CHANNELS] = {255,255,255};       /**< in wire order */
+#endif
+
+static uint32_t Get_TimClockKHz(void);
+static uint8_t Timing_Ok(tTimingProfile const *profile);
+static uint32_t Apply_OutputTiming(tTimingProfile const *profile);
+static void Apply_Timing(tTimingProfile const *profile);
 static void Init_DMA(void);
-static void Init_TIM(void);
-static void Start_DMA(void);
+static void Init_Output(void);
+static void Init_LatchTimer(void);
+static void Start_LatchTimer(void);
+#if WS2812_FULL_FRAME
+static void Encode_Frame(void);
+#else
+static void Refill_DMA_Buffer(uint8_t bufferPos);
 static void Setup_DMA_Buffer(uint8_t bufferPos);
+#endif
+static void Start_DMA(void);
+static void Stop_Output(void);
+static void Start_Frame(void);
+static uint8_t Claim_Output(void);
+static void Hold_Output(uint8_t withGap);
+static void Commit_Frame(uint32_t numLeds);
+static void Update_OutputLength(void);
+static void Invalidate_LastFrame(void);
+#if POWER_SUMS
+static inline void Power_Account(tFramePixel const *pixel, int32_t weight);
+static inline uint32_t Power_Counted(tFramePixel const *pixels, uint32_t numLeds);
+static inline void Power_AccountSpan(tFramePixel const *pixels, uint32_t numLeds, int32_t weight);
+#endif
+#if WS2812_POWER_LIMIT
+static void Limit_Power(void);
+#endif
+#if WS2812_RLE
+static uint8_t Rle_Seat(uint32_t first);
+static uint8_t Rle_Fill(tFramePixel value, uint32_t numLeds);
+static tFramePixel const *Rle_Find(uint8_t buffer, uint32_t led);
+static void Rle_Copy(tRGB_Buffer *dst, tRGB_Buffer const *src);
+#endif
+#if WS2812_DEDUP
+static uint32_t Frame_Crc(uint8_t buffer, uint32_t numLeds);
+#endif
+#if WS2812_SINGLE_BUFFER
+static inline void Check_Tear(uint32_t first, uint32_t numLeds);
+#endif
+static void Build_GammaCurve(void);
+static void Fill_CorrectionLut(void);
+static void Build_CorrectionLut(void);
+static void Swap_CorrectionLut(void);
+
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+// 5 and 6 bit channels to 8 bit, the high bits get repeated so white stays 255
+static inline void Expand_Rgb565(uint16_t value, tPixel *color){
+	uint32_t r = value >> 11;
+	uint32_t g = (value >> 5) & 0x3F;
+	uint32_t b = value & 0x1F;
+	color->c[WIRE_R] = (uint8_t)((r << 3) | (r >> 2));
+	color->c[WIRE_G] = (uint8_t)((g << 2) | (g >> 4));
+	color->c[WIRE_B] = (uint8_t)((b << 3) | (b >> 2));
+#if WS2812_RGBW
+	color->c[WIRE_W] = 0;
+#endif
+}
+#endif
+
+// color of a stored pixel of the framebuffer, compact formats get expanded into expanded
+static inline tPixel const *Stored_Color(uint8_t buffer, tFramePixel const *stored, tPixel *expanded){
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	(void)expanded;
+	return &palette[buffer][*stored];
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+	(void)buffer;
+	Expand_Rgb565(*stored,expanded);
+	return expanded;
+#else
+	(void)buffer;
+	(void)expanded;
+	return stored;
+#endif
+}
+
+// color of a framebuffer led
+static inline tPixel const *Led_Color(uint8_t buffer, uint32_t led, tPixel *expanded){
+#if WS2812_RLE
+	return Stored_Color(buffer,Rle_Find(buffer,led),expanded);
+#else
+	return Stored_Color(buffer,&rgbBuffer[buffer][led],expanded);
+#endif
+}
+
+#if COMPACT_FORMAT || WS2812_RLE
+static void Store_Led(uint32_t lednum, tFramePixel value){
+#if WS2812_RLE
+	if(Rle_Seat(lednum)){
+		Rle_Fill(value,1);
+	}
+#else
+	tFramePixel *pixel = &rgbBuffer[nextRGBIdx][lednum];
+	POWER_REMOVE(pixel);
+	*pixel = value;
+	POWER_ADD(pixel);
+#endif
+}
+#endif
+
+#if SPAN_WORDS
+// fills the pixels with the value, 4 leds at a time with a 3 word pattern
+static void Fill_Pixels(tFramePixel *pixel, uint32_t numLeds, tFramePixel value){
+	uint32_t pattern[3];
+	for(uint32_t k = 0; k<4; ++k){
+		memcpy((uint8_t *)pattern + k * sizeof(tFramePixel),&value,sizeof(tFramePixel));
+	}
+
+	for(uint32_t i = 0; i<numLeds;){
+		if((((uintptr_t)&pixel[i] & 0x3) == 0) && (numLeds - i >= 4)){
+			memcpy(&pixel[i],pattern,sizeof(pattern));
+			i += 4;
+		}
+		else{
+			pixel[i++] = value;
+		}
+	}
+}
+
+#if !SPAN_COPY
+// converts r, g, b bytes into wire order, 4 leds at a time: 3 words in, 3 words out
+static void Write_Pixels(tFramePixel *pixel, uint32_t numLeds, uint8_t const *rgb){
+	for(uint32_t i = 0; i<numLeds;){
+		if((((uintptr_t)&pixel[i] & 0x3) == 0) && (numLeds - i >= 4)){
+			uint32_t in[3], out[3];
+			memcpy(in,rgb,sizeof(in));
+			out[0] = WIRE_WORD(in,0);
+			out[1] = WIRE_WORD(in,1);
+			out[2] = WIRE_WORD(in,2);
+			memcpy(&pixel[i],out,sizeof(out));
+			i += 4;
+			rgb += sizeof(in);
+		}
+		else{
+			pixel[i].c[WIRE_R] = rgb[0];
+			pixel[i].c[WIRE_G] = rgb[1];
+			pixel[i].c[WIRE_B] = rgb[2];
+			i++;
+			rgb += 3;
+		}
+	}
+}
+#endif
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
 
+// rgb 3-3-2 palette, matches the index of WS2812_SetLed
+static void Init_Palette(void){
+	for(uint32_t b = 0; b<FRAME_BUFFERS; ++b){
+		for(uint32_t i = 0; i<256; ++i){
+			tPixel *entry = &palette[b][i];
+			entry->c[WIRE_R] = (uint8_t)(((i >> 5) * 255) / 7);
+			entry->c[WIRE_G] = (uint8_t)((((i >> 2) & 7) * 255) / 7);
+			entry->c[WIRE_B] = (uint8_t)(((i & 3) * 255) / 3);
+#if WS2812_RGBW
+			entry->c[WIRE_W] = 0;
+#endif
+		}
+	}
+}
+#endif
 
 void WS2812_Init(void){
 	//enable clocks
 	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB, ENABLE);
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI2, ENABLE);
+#else
 	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM4, ENABLE);
+#endif
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
 	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+#if WS2812_DEDUP
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC, ENABLE);
+#endif
 
 	//set all values to "off"
 	memset(rgbBuffer,0,sizeof(rgbBuffer));
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	Init_Palette();
+#endif
 
-	Init_TIM();
-	Init_DMA();
+	Build_GammaCurve();
+	Build_CorrectionLut();
+	Swap_CorrectionLut();
 
-	TIM_DMACmd(TIM4, TIM_DMA_CC1, ENABLE);
+	Init_LatchTimer();
+	Apply_Timing(&timingProfiles[WS2812_LED_TYPE]);
+	Init_Output();
+	Init_DMA();
 }
 
 
 void WS2812_Refresh(uint32_t numLeds){
-	if(numLeds > MAX_LED_NUM){
-		lednumToTransmit = MAX_LED_NUM;
+#if WS2812_DEDUP
+	// the leds already show this frame: nothing to send, dithering and fading go on
+	uint32_t crc = Frame_Crc(nextRGBIdx,(numLeds > MAX_LED_NUM) ? MAX_LED_NUM : numLeds);
+	dedupStats.frames++;
+	if(lastFrameValid && crc == lastFrameCrc){
+		dedupStats.duplicates++;
+		return;
 	}
-	else{
-		lednumToTransmit = numLeds;
+	lastFrameCrc = crc;
+	lastFrameValid = 1;
+#endif
+
+	// a frame is on the wire: the latch isr sends this one after it (a repeat gets cut short), no waiting here
+	__disable_irq();
+	if(transferRunning){
+		pendingLeds = numLeds;
+		refreshPending = 1;
+		__enable_irq();
+		return;
+	}
+	transferRunning = 1;    // claimed, a refresh from an isr until the start becomes pending
+	__enable_irq();
+
+	Commit_Frame(numLeds);
+}
+
+uint8_t WS2812_SetTiming(uint8_t ledType){
+	if(ledType >= sizeof(timingProfiles)/sizeof(timingProfiles[0])){
+		return 0;
 	}
 
-	while(transferComplete == 0);
+	tTimingProfile const *p = &timingProfiles[ledType];
 
-	uint8_t tmp = currentRGBIdx;
-	currentRGBIdx = nextRGBIdx;
-	nextRGBIdx = tmp;
+	if(!Timing_Ok(p)){
+		return 0;
+	}
 
-	currentLEDIdx = 0;
-	sendResetPulse = 0;
-	resetPulseIdx = 0;
-	Setup_DMA_Buffer(0);
-	Setup_DMA_Buffer(1);
-	Start_DMA();
+	// let the current frame and its latch gap finish with the old timing
+	Hold_Output(1);
+	Apply_Timing(p);
+	__enable_irq();
 
-	memcpy(rgbBuffer[nextRGBIdx],rgbBuffer[currentRGBIdx],sizeof(tRGB_Buffer));
+	if((lednumToTransmit != 0) && Claim_Output()){
+		frameFresh = 1;
+		Start_Frame();
+	}
+	return 1;
 }
 
 void WS2812_SetLed(uint32_t lednum, tWS2812_RGB const * color){
 	if(lednum<MAX_LED_NUM){
-		rgbBuffer[nextRGBIdx][lednum] = *color;
+		TEAR_CHECK(lednum,1);
+#if COMPACT_FORMAT
+		Store_Led(lednum,TO_STORED(color->r,color->g,color->b));
+#else
+		tPixel *pixel = BACK_PIXEL(lednum);
+		POWER_REMOVE(pixel);
+		pixel->c[WIRE_R] = TO_PIXEL(color->r);
+		pixel->c[WIRE_G] = TO_PIXEL(color->g);
+		pixel->c[WIRE_B] = TO_PIXEL(color->b);
+#if WS2812_RGBW
+		pixel->c[WIRE_W] = 0;
+#endif
+		POWER_ADD(pixel);
+		STORE_PIXEL(lednum,pixel);
+#endif
+	}
+}
+
+void WS2812_SetLed16(uint32_t lednum, tWS2812_RGB16 const * color){
+	if(lednum<MAX_LED_NUM){
+		TEAR_CHECK(lednum,1);
+#if COMPACT_FORMAT
+		Store_Led(lednum,TO_STORED(TO_PIXEL16(color->r),TO_PIXEL16(color->g),TO_PIXEL16(color->b)));
+#else
+		tPixel *pixel = BACK_PIXEL(lednum);
+		POWER_REMOVE(pixel);
+		pixel->c[WIRE_R] = TO_PIXEL16(color->r);
+		pixel->c[WIRE_G] = TO_PIXEL16(color->g);
+		pixel->c[WIRE_B] = TO_PIXEL16(color->b);
+#if WS2812_RGBW
+		pixel->c[WIRE_W] = 0;
+#endif
+		POWER_ADD(pixel);
+		STORE_PIXEL(lednum,pixel);
+#endif
 	}
 }
 
+#if WS2812_RGBW
+void WS2812_SetLedRGBW(uint32_t lednum, tWS2812_RGBW const * color){
+	if(lednum<MAX_LED_NUM){
+		TEAR_CHECK(lednum,1);
+#if COMPACT_FORMAT
+		Store_Led(lednum,TO_STORED(color->r,color->g,color->b));
+#else
+		tPixel *pixel = BACK_PIXEL(lednum);
+		POWER_REMOVE(pixel);
+		pixel->c[WIRE_R] = TO_PIXEL(color->r);
+		pixel->c[WIRE_G] = TO_PIXEL(color->g);
+		pixel->c[WIRE_B] = TO_PIXEL(color->b);
+		pixel->c[WIRE_W] = TO_PIXEL(color->w);
+		POWER_ADD(pixel);
+		STORE_PIXEL(lednum,pixel);
+#endif
+	}
+}
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+void WS2812_SetLedIndex(uint32_t lednum, uint8_t index){
+	if(lednum<MAX_LED_NUM){
+		TEAR_CHECK(lednum,1);
+		Store_Led(lednum,index);
+	}
+}
+
+void WS2812_SetPalette(uint32_t first, uint32_t numColors, tWS2812_RGB const * colors){
+	TEAR_CHECK(0,MAX_LED_NUM);    // every led can use the entries
+	for(uint32_t i = 0; i<numColors && first + i < 256; ++i){
+		tPixel *entry = &palette[nextRGBIdx][first + i];
+		entry->c[WIRE_R] = colors[i].r;
+		entry->c[WIRE_G] = colors[i].g;
+		entry->c[WIRE_B] = colors[i].b;
+#if WS2812_RGBW
+		entry->c[WIRE_W] = 0;
+#endif
+	}
+}
+
+uint8_t WS2812_GetLedIndex(uint32_t lednum){
+#if WS2812_RLE
+	return (lednum < MAX_LED_NUM) ? *Rle_Find(nextRGBIdx,lednum) : 0;
+#else
+	return (lednum < MAX_LED_NUM) ? rgbBuffer[nextRGBIdx][lednum] : 0;
+#endif
+}
+#endif
+
 void WS2812_SetAllLeds(uint32_t numLeds, tWS2812_RGB const * color){
-	if(numLeds>MAX_LED_NUM){
-		numLeds = MAX_LED_NUM;
+	WS2812_FillLeds(0,numLeds,color);
+}
+
+void WS2812_FillLeds(uint32_t first, uint32_t numLeds, tWS2812_RGB const * color){
+	if(first >= MAX_LED_NUM){
+		return;
+	}
+	if(numLeds > MAX_LED_NUM - first){
+		numLeds = MAX_LED_NUM - first;
+	}
+	TEAR_CHECK(first,numLeds);
+
+	// convert once, the run gets filled with copies
+	tFramePixel value;
+#if COMPACT_FORMAT
+	value = TO_STORED(color->r,color->g,color->b);
+#else
+	value.c[WIRE_R] = TO_PIXEL(color->r);
+	value.c[WIRE_G] = TO_PIXEL(color->g);
+	value.c[WIRE_B] = TO_PIXEL(color->b);
+#if WS2812_RGBW
+	value.c[WIRE_W] = 0;
+#endif
+#endif
+
+#if WS2812_RLE
+	if(Rle_Seat(first)){
+		Rle_Fill(value,numLeds);    // one run, or the run before grows
+	}
+#else
+	tFramePixel *pixel = &rgbBuffer[nextRGBIdx][first];
+	POWER_REMOVE_SPAN(pixel,numLeds);
+#if SPAN_WORDS
+	Fill_Pixels(pixel,numLeds,value);
+#else
+	for(uint32_t i = 0; i<numLeds; ++i){
+		pixel[i] = value;
+	}
+#endif
+#if POWER_SUMS
+	Power_Account(&value,(int32_t)Power_Counted(pixel,numLeds));
+#endif
+#endif
+}
+
+void WS2812_WriteLeds(uint32_t first, uint32_t numLeds, uint8_t const * rgb){
+	if(first >= MAX_LED_NUM){
+		return;
+	}
+	if(numLeds > MAX_LED_NUM - first){
+		numLeds = MAX_LED_NUM - first;
+	}
+	TEAR_CHECK(first,numLeds);
+
+#if WS2812_RLE
+	// led by led, equal neighbours grow a fill run
+	for(uint32_t i = 0; i<numLeds; ++i, rgb += 3){
+		tWS2812_RGB color = {rgb[0], rgb[1], rgb[2]};
+		WS2812_SetLed(first + i,&color);
+	}
+#else
+	tFramePixel *pixel = &rgbBuffer[nextRGBIdx][first];
+	POWER_REMOVE_SPAN(pixel,numLeds);
+#if SPAN_COPY
+	memcpy(pixel,rgb,numLeds * sizeof(tFramePixel));
+#elif SPAN_WORDS
+	Write_Pixels(pixel,numLeds,rgb);
+#else
+	for(uint32_t i = 0; i<numLeds; ++i, rgb += 3){
+#if COMPACT_FORMAT
+		pixel[i] = TO_STORED(rgb[0],rgb[1],rgb[2]);
+#else
+		pixel[i].c[WIRE_R] = TO_PIXEL(rgb[0]);
+		pixel[i].c[WIRE_G] = TO_PIXEL(rgb[1]);
+		pixel[i].c[WIRE_B] = TO_PIXEL(rgb[2]);
+#if WS2812_RGBW
+		pixel[i].c[WIRE_W] = 0;
+#endif
+#endif
+	}
+#endif
+	POWER_ADD_SPAN(pixel,numLeds);
+#endif
+}
+
+void WS2812_CopyLeds(uint32_t dst, uint32_t src, uint32_t numLeds){
+	if(dst >= MAX_LED_NUM || src >= MAX_LED_NUM){
+		return;
+	}
+	uint32_t last = (dst > src) ? dst : src;
+	if(numLeds > MAX_LED_NUM - last){
+		numLeds = MAX_LED_NUM - last;
 	}
-	for(uint32_t i = 0; i<numLeds;i++){
-		WS2812_SetLed(i,color);
+	TEAR_CHECK(dst,numLeds);
+
+#if WS2812_RLE
+	for(uint32_t i = 0; i<numLeds; ++i){
+		Store_Led(dst + i,*Rle_Find(nextRGBIdx,src + i));
 	}
+#else
+	tFramePixel *pixel = &rgbBuffer[nextRGBIdx][dst];
+	POWER_REMOVE_SPAN(pixel,numLeds);
+	memmove(pixel,&rgbBuffer[nextRGBIdx][src],numLeds * sizeof(tFramePixel));
+	POWER_ADD_SPAN(pixel,numLeds);
+#endif
+}
+
+void * WS2812_GetBackBuffer(void){
+#if WS2812_RLE
+	return 0;
+#else
+#if POWER_SUMS
+	powerRecount = 1;
+#endif
+	return rgbBuffer[nextRGBIdx];
+#endif
 }
 
 tWS2812_RGB WS2812_GetLed(uint32_t lednum){
@@ -114,16 +883,53 @@ tWS2812_RGB WS2812_GetLed(uint32_t lednum){
 	memset(&color,0,sizeof(tWS2812_RGB));
 
 	if(lednum < MAX_LED_NUM){
-		color = rgbBuffer[nextRGBIdx][lednum];
+		tPixel expanded;
+		tPixel const *pixel = Led_Color(nextRGBIdx,lednum,&expanded);
+		color.r = FROM_PIXEL(pixel->c[WIRE_R]);
+		color.g = FROM_PIXEL(pixel->c[WIRE_G]);
+		color.b = FROM_PIXEL(pixel->c[WIRE_B]);
+	}
+
+	return color;
+}
+
+tWS2812_RGB16 WS2812_GetLed16(uint32_t lednum){
+	tWS2812_RGB16 color;
+	memset(&color,0,sizeof(tWS2812_RGB16));
+
+	if(lednum < MAX_LED_NUM){
+		tPixel expanded;
+		tPixel const *pixel = Led_Color(nextRGBIdx,lednum,&expanded);
+		color.r = FROM_PIXEL16(pixel->c[WIRE_R]);
+		color.g = FROM_PIXEL16(pixel->c[WIRE_G]);
+		color.b = FROM_PIXEL16(pixel->c[WIRE_B]);
+	}
+
+	return color;
+}
+
+#if WS2812_RGBW
+tWS2812_RGBW WS2812_GetLedRGBW(uint32_t lednum){
+	tWS2812_RGBW color;
+	memset(&color,0,sizeof(tWS2812_RGBW));
+
+	if(lednum < MAX_LED_NUM){
+		tPixel expanded;
+		tPixel const *pixel = Led_Color(nextRGBIdx,lednum,&expanded);
+		color.r = FROM_PIXEL(pixel->c[WIRE_R]);
+		color.g = FROM_PIXEL(pixel->c[WIRE_G]);
+		color.b = FROM_PIXEL(pixel->c[WIRE_B]);
+		color.w = FROM_PIXEL(pixel->c[WIRE_W]);
 	}
 
 	return color;
 }
+#endif
 
 uint8_t WS2812_TransferComplete(void){
-	NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+	NVIC_DisableIRQ(TIM3_IRQn);
 	uint8_t tmp = transferComplete;
-	NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+	NVIC_EnableIRQ(TIM3_IRQn);
 	if(tmp == 1){
 		transferComplete = 0;
 	}
@@ -134,63 +940,426 @@ void WS2812_SetTransferCompleteCallback(void (*cb)(void)){
 	transferCompleteCb = cb;
 }
 
+void WS2812_SetGamma(uint16_t gamma){
+	if(gamma == 0){
+		gamma = 100;
+	}
+	gammaValue = gamma;
+	Build_GammaCurve();
+	Build_CorrectionLut();
+}
+
+void WS2812_SetBrightness(uint8_t value){
+	brightness = value;
+	Build_CorrectionLut();
+}
 
-void DMA1_Channel1_IRQHandler(void){
+void WS2812_SetWhiteBalance(uint8_t r, uint8_t g, uint8_t b){
+	whiteBalance[WIRE_R] = r;
+	whiteBalance[WIRE_G] = g;
+	whiteBalance[WIRE_B] = b;
+	Build_CorrectionLut();
+}
 
-	if(DMA_GetITStatus(DMA1_IT_HT1)){
-		DMA_ClearITPendingBit(DMA1_IT_HT1);
 
-		// initialize first half of dma buffer
-		Setup_DMA_Buffer(0);
+#if WS2812_DEDUP
+tWS2812_DedupStats WS2812_GetDedupStats(void){
+	return dedupStats;
+}
+#endif
+
+#if WS2812_SINGLE_BUFFER
+uint32_t WS2812_GetTearCount(void){
+	return tearCount;
+}
+#endif
+
+#if WS2812_RLE
+uint32_t WS2812_GetRleDrops(void){
+	return rleDrops;
+}
+#endif
+
+#if WS2812_POWER_LIMIT
+void WS2812_SetPowerLimit(tWS2812_PowerModel const * model, uint32_t budgetMa){
+	powerUa[WIRE_R] = model->r;
+	powerUa[WIRE_G] = model->g;
+	powerUa[WIRE_B] = model->b;
+#if WS2812_RGBW
+	powerUa[WIRE_W] = model->w;
+#endif
+	powerIdleUa = model->idle;
+	powerBudgetMa = budgetMa;
+	Invalidate_LastFrame();    // a duplicate refresh has to apply it
+}
+
+uint32_t WS2812_GetPowerEstimate(void){
+	return powerEstimateMa;
+}
+#endif
 
+#if WS2812_SMOOTHING
+void WS2812_SetSmoothing(uint8_t factor){
+	smoothGain = (uint16_t)(256 - factor);
+}
+#endif
+
+#if WS2812_SCALING
+uint8_t WS2812_SetScaling(uint32_t numLeds, uint8_t mode){
+	if(numLeds > MAX_OUTPUT_LEDS || mode > WS2812_SCALE_LINEAR){
+		return 0;
 	}
-	else if(DMA_GetITStatus(DMA1_IT_TC1)){
-		DMA_ClearITPendingBit(DMA1_IT_TC1);
 
-		if(resetPulseIdx < RESET_PULSE_CNTS){
-			// initialize second half of dma buffer
-			Setup_DMA_Buffer(1);
+	// the encoder reads the scaling until the frame has been sent
+	Hold_Output(0);
+	scaleLength = numLeds;
+	scaleMode = mode;
+	Update_OutputLength();
+	Invalidate_LastFrame();
+	__enable_irq();
+	return 1;
+}
+#endif
+
+#if WS2812_REMAP
+uint8_t WS2812_SetRemapTable(uint16_t const * table, uint32_t length){
+	if(table != 0){
+		if(length > MAX_OUTPUT_LEDS){
+			return 0;
 		}
-		else{
+		for(uint32_t i = 0; i<length; ++i){
+			if(table[i] >= MAX_REMAP_LED){
+				return 0;
+			}
+		}
+	}
+	else{
+		length = 0;
+	}
+
+	// the encoder reads the remap until the frame has been sent
+	Hold_Output(0);
+	remapRuns = 0;
+	remapTable = table;
+	remapLength = length;
+	Update_OutputLength();
+	Invalidate_LastFrame();
+	__enable_irq();
+	return 1;
+}
+
+uint8_t WS2812_SetRemapRuns(tWS2812_Run const * runs, uint32_t numRuns){
+	uint32_t length = 0;
+
+	if(runs != 0){
+		for(uint32_t i = 0; i<numRuns; ++i){
+			tWS2812_Run const *run = &runs[i];
+			int32_t last = (int32_t)run->start + ((int32_t)run->count - 1) * run->step;
+
+			if(run->count == 0 || run->start >= MAX_REMAP_LED || last < 0 || last >= MAX_REMAP_LED){
+				return 0;
+			}
+			length += (uint32_t)run->count * (run->repeat != 0 ? run->repeat : 1);
+		}
+		if(length > MAX_OUTPUT_LEDS){
+			return 0;
+		}
+	}
+
+	// the encoder reads the remap until the frame has been sent
+	Hold_Output(0);
+	remapTable = 0;
+	remapRuns = (length != 0) ? runs : 0;
+	remapLength = length;
+	Update_OutputLength();
+	Invalidate_LastFrame();
+	__enable_irq();
+	return 1;
+}
+#endif
+
+
+void WS2812_DMA_IRQHandler(void){
+	CYCLE_BUDGET_BEGIN();
+
+#if WS2812_FULL_FRAME
+	if(DMA_GetITStatus(WS2812_DMA_IT_TC)){
+		DMA_ClearITPendingBit(WS2812_DMA_IT_TC);
+
+		// the whole frame has been handed to the peripheral, the zero follows the last bit
+		Start_LatchTimer();
+	}
+#else
+	if(DMA_GetITStatus(WS2812_DMA_IT_HT)){
+		DMA_ClearITPendingBit(WS2812_DMA_IT_HT);
+
+		// initialize first half of dma buffer
+		Refill_DMA_Buffer(0);
+
+	}
+	else if(DMA_GetITStatus(WS2812_DMA_IT_TC)){
+		DMA_ClearITPendingBit(WS2812_DMA_IT_TC);
+
+		// initialize second half of dma buffer
+		Refill_DMA_Buffer(1);
+	}
+#endif
+
+	CYCLE_BUDGET_END(CycleBudget_WS2812_Refill);
+}
+
+void TIM3_IRQHandler(void){
+	CYCLE_BUDGET_BEGIN();
+	if(TIM_GetITStatus(TIM3,TIM_IT_CC1)){
+		TIM_ClearITPendingBit(TIM3,TIM_IT_CC1);
+
+		// the last led has been sent and the line is low: hold it low and free the dma buffer
+		Stop_Output();
+		gapActive = 1;
+
+		// the frame is complete after its first transfer, the repeats don't count
+		if(frameFresh){
+			frameFresh = 0;
 			transferComplete = 1;
-			DMA_Cmd(DMA1_Channel1,DISABLE);
 
 			if(transferCompleteCb != 0){
 				transferCompleteCb();
 			}
 		}
+
+		if(refreshPending){
+			// a refresh came in during the frame: it starts after this gap
+			refreshPending = 0;
+			Commit_Frame(pendingLeds);
+		}
+		else if(!WS2812_FULL_FRAME && !refreshRequested && ((lutPending && !lutBuilding) || REPEAT_FRAMES || SMOOTHING_MOVED)){
+			// no new frame yet: show the last one again with the new correction / next dither, crossfade or smoothing step
+			Swap_CorrectionLut();
+			Start_Frame();
+		}
+		else{
+			transferRunning = 0;
+		}
+	}
+
+	if(TIM_GetITStatus(TIM3,TIM_IT_Update)){
+		TIM_ClearITPendingBit(TIM3,TIM_IT_Update);
+
+		// reset time is over, the next frame has been encoded during the gap
+		gapActive = 0;
+		if(frameArmed){
+			frameArmed = 0;
+			Start_DMA();
+		}
 	}
+	CYCLE_BUDGET_END(CycleBudget_WS2812_Latch);
 }
 
 
 static void Init_DMA(void){
 
 	DMA_InitTypeDef dmaInit;
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+	dmaInit.DMA_PeripheralBaseAddr = (uint32_t)&SPI2->DR;
+	dmaInit.DMA_PeripheralDataSize =  DMA_PeripheralDataSize_Byte;
+#else
 	dmaInit.DMA_PeripheralBaseAddr = (uint32_t)&TIM4->CCR1;
+	dmaInit.DMA_PeripheralDataSize =  DMA_PeripheralDataSize_HalfWord;
+#endif
 	dmaInit.DMA_MemoryBaseAddr = (uint32_t)(dmaBuffer);
 	dmaInit.DMA_DIR = DMA_DIR_PeripheralDST;
 	dmaInit.DMA_BufferSize = sizeof(dmaBuffer);
 	dmaInit.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
 	dmaInit.DMA_MemoryInc = DMA_MemoryInc_Enable;
-	dmaInit.DMA_PeripheralDataSize =  DMA_PeripheralDataSize_HalfWord;
 	dmaInit.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+#if WS2812_FULL_FRAME
+	dmaInit.DMA_Mode = DMA_Mode_Normal;
+#else
 	dmaInit.DMA_Mode = DMA_Mode_Circular;
+#endif
 	dmaInit.DMA_Priority = DMA_Priority_High;
 	dmaInit.DMA_M2M = DMA_M2M_Disable;
-	DMA_Init(DMA1_Channel1, &dmaInit);
+	DMA_Init(WS2812_DMA, &dmaInit);
 
 	// Initialize dma interrupt
-	DMA_ITConfig(DMA1_Channel1,DMA_IT_TC,ENABLE);
-	DMA_ITConfig(DMA1_Channel1,DMA_IT_HT,ENABLE);
+	DMA_ITConfig(WS2812_DMA,DMA_IT_TC,ENABLE);
+#if !WS2812_FULL_FRAME
+	DMA_ITConfig(WS2812_DMA,DMA_IT_HT,ENABLE);
+#endif
 	NVIC_InitTypeDef dmaNVIC;
-	dmaNVIC.NVIC_IRQChannel = DMA1_Channel1_IRQn;
+	dmaNVIC.NVIC_IRQChannel = WS2812_DMA_IRQn;
 	dmaNVIC.NVIC_IRQChannelCmd = ENABLE;
 	dmaNVIC.NVIC_IRQChannelPreemptionPriority = 0;
 	dmaNVIC.NVIC_IRQChannelSubPriority = 0;
 	NVIC_Init(&dmaNVIC);
 }
 
-static void Init_TIM(void){
+// TIM3 one pulse: compare 1 stops the output after the last led, the update ends the latch gap
+static void Init_LatchTimer(void){
+	TIM_TimeBaseInitTypeDef timInit;
+	timInit.TIM_Prescaler = 0;
+	timInit.TIM_Period = 0xFFFF;
+	timInit.TIM_ClockDivision = TIM_CKD_DIV1;
+	timInit.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(TIM3, &timInit);
+	TIM_SelectOnePulseMode(TIM3, TIM_OPMode_Single);
+
+	TIM_ClearITPendingBit(TIM3, TIM_IT_CC1 | TIM_IT_Update);
+	TIM_ITConfig(TIM3, TIM_IT_CC1 | TIM_IT_Update, ENABLE);
+
+	NVIC_InitTypeDef timNVIC;
+	timNVIC.NVIC_IRQChannel = TIM3_IRQn;
+	timNVIC.NVIC_IRQChannelCmd = ENABLE;
+	timNVIC.NVIC_IRQChannelPreemptionPriority = 0;
+	timNVIC.NVIC_IRQChannelSubPriority = 0;
+	NVIC_Init(&timNVIC);
+}
+
+// gets called when the zeros after the last led are in the dma buffer, the last leds are still
+// in the other half. They are on the line within tailBits + LATCH_LAG_BITS and the dma reaches
+// them again after 2 * HALF_BITS, so the output gets stopped in between (compare 1)
+static void Start_LatchTimer(void){
+	uint32_t lowNs = (tailBits + LATCH_LAG_BITS) * bitNs;
+
+	TIM_Cmd(TIM3,DISABLE);
+	TIM3->CNT = 0;
+	TIM3->CCR1 = (uint16_t)((lowNs + 2 * bitNs + 999) / 1000);
+	TIM3->ARR = (uint16_t)((lowNs + resetNs + 999) / 1000 - 1);
+	TIM_Cmd(TIM3,ENABLE);
+}
+
+// TIM3 / TIM4 run with PCLK1, doubled if APB1 is divided
+static uint32_t Get_TimClockKHz(void){
+	RCC_ClocksTypeDef clocks;
+	RCC_GetClocksFreq(&clocks);
+
+	uint32_t clock = clocks.PCLK1_Frequency;
+	if(clocks.HCLK_Frequency != clocks.PCLK1_Frequency){
+		clock *= 2;
+	}
+	return clock / 1000;
+}
+
+static void Apply_Timing(tTimingProfile const *profile){
+	uint32_t timClockKHz = Get_TimClockKHz();
+
+	bitNs = Apply_OutputTiming(profile);
+	resetNs = profile->reset;
+
+	TIM_PrescalerConfig(TIM3,(uint16_t)(timClockKHz / 1000 - 1),TIM_PSCReloadMode_Immediate);
+	TIM_ClearITPendingBit(TIM3,TIM_IT_CC1 | TIM_IT_Update);
+}
+
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+
+static uint8_t spiPrescaler = 0;    /**< spi clock = PCLK1 >> spiPrescaler */
+
+static uint32_t Get_SpiClockKHz(void){
+	RCC_ClocksTypeDef clocks;
+	RCC_GetClocksFreq(&clocks);
+	return clocks.PCLK1_Frequency / 1000;
+}
+
+// fastest spi clock which meets the profile with 3 spi bits per bit, 0 if there is none
+static uint8_t Find_SpiPrescaler(tTimingProfile const *p){
+	uint32_t pclkKHz = Get_SpiClockKHz();
+
+	for(uint8_t shift = 1; shift <= 8; ++shift){
+		uint32_t clockKHz = pclkKHz >> shift;
+		if(SPI_TIMING_OK_(clockKHz,p->bit,p->t1h,p->t0h,p->bitMin,p->bitMax,p->t1hMin,p->t1hMax,
+		                  p->t0hMin,p->t0hMax,p->t1lMin,p->t1lMax,p->t0lMin,p->t0lMax,p->reset)){
+			return shift;
+		}
+	}
+	return 0;
+}
+
+static uint8_t Timing_Ok(tTimingProfile const *profile){
+	return Find_SpiPrescaler(profile) != 0;
+}
+
+// returns the resulting bit time in ns
+static uint32_t Apply_OutputTiming(tTimingProfile const *profile){
+	spiPrescaler = Find_SpiPrescaler(profile);
+	if(spiPrescaler == 0){
+		spiPrescaler = SPI_DEFAULT_PRESCALER;
+	}
+
+	// before Init_Output the prescaler only gets stored, Init_Output configures and enables the spi with it
+	if(SPI2->CR1 & SPI_CR1_SPE){
+		SPI_Cmd(SPI2,DISABLE);
+		SPI2->CR1 = (SPI2->CR1 & ~SPI_CR1_BR) | ((spiPrescaler - 1) << 3);
+		SPI_Cmd(SPI2,ENABLE);
+	}
+
+	return TICKS_TO_NS(SPI_BITS_PER_BIT,Get_SpiClockKHz() >> spiPrescaler);
+}
+
+static void Init_Output(void){
+	//initialize PB15 as spi mosi, the clock pin isn't used
+
+	GPIO_InitTypeDef spiGPIO;
+	spiGPIO.GPIO_Pin = GPIO_Pin_15;
+	spiGPIO.GPIO_Speed = GPIO_Speed_50MHz;
+	spiGPIO.GPIO_Mode = GPIO_Mode_AF_PP;
+	GPIO_Init(GPIOB, &spiGPIO);
+
+	SPI_InitTypeDef spiInit;
+	SPI_StructInit(&spiInit);
+	spiInit.SPI_Direction = SPI_Direction_1Line_Tx;
+	spiInit.SPI_Mode = SPI_Mode_Master;
+	spiInit.SPI_DataSize = SPI_DataSize_8b;
+	spiInit.SPI_CPOL = SPI_CPOL_Low;
+	spiInit.SPI_CPHA = SPI_CPHA_1Edge;
+	spiInit.SPI_NSS = SPI_NSS_Soft;
+	spiInit.SPI_BaudRatePrescaler = (uint16_t)((spiPrescaler - 1) << 3);
+	spiInit.SPI_FirstBit = SPI_FirstBit_MSB;
+	SPI_Init(SPI2, &spiInit);
+	SPI_NSSInternalSoftwareConfig(SPI2, SPI_NSSInternalSoft_Set);
+	SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
+	SPI_Cmd(SPI2, ENABLE);
+}
+
+// the spi requests data as long as the dma is enabled
+static void Start_DMA(void){
+	DMA_Cmd(WS2812_DMA,DISABLE);
+	DMA_SetCurrDataCounter(WS2812_DMA,dmaTransferSize);
+	DMA_Cmd(WS2812_DMA,ENABLE);
+
+	if(tailStarted){
+		Start_LatchTimer();
+	}
+}
+
+// mosi stays low after the zeros
+static void Stop_Output(void){
+	DMA_Cmd(WS2812_DMA,DISABLE);
+}
+
+#else
+
+static uint8_t Timing_Ok(tTimingProfile const *p){
+	uint32_t clockKHz = Get_TimClockKHz();
+	return TIMING_OK_(clockKHz,p->bit,p->t1h,p->t0h,p->bitMin,p->bitMax,p->t1hMin,p->t1hMax,
+	                  p->t0hMin,p->t0hMax,p->t1lMin,p->t1lMax,p->t0lMin,p->t0lMax,p->reset);
+}
+
+// returns the resulting bit time in ns
+static uint32_t Apply_OutputTiming(tTimingProfile const *profile){
+	uint32_t clockKHz = Get_TimClockKHz();
+	uint32_t period = NS_TO_TICKS(profile->bit,clockKHz);
+	uint32_t t1h = NS_TO_TICKS(profile->t1h,clockKHz);
+
+	timReload = (uint16_t)(period - 1);
+	dutyT0H = (uint8_t)NS_TO_TICKS(profile->t0h,clockKHz);
+	dutyDiff = (uint8_t)(t1h - dutyT0H);
+
+	TIM_SetAutoreload(TIM4,timReload);
+	return TICKS_TO_NS(period,clockKHz);
+}
+
+static void Init_Output(void){
 	//initialize PB6 as pwm pin
 
 	GPIO_InitTypeDef pwmGPIO;
@@ -201,7 +1370,7 @@ static void Init_TIM(void){
 
 	TIM_TimeBaseInitTypeDef timInit;
 	timInit.TIM_Prescaler = 0;
-	timInit.TIM_Period = 89;
+	timInit.TIM_Period = timReload;
 	timInit.TIM_ClockDivision = TIM_CKD_DIV1;
 	timInit.TIM_CounterMode = TIM_CounterMode_Up;
 	TIM_TimeBaseInit(TIM4, &timInit);
@@ -213,17 +1382,850 @@ static void Init_TIM(void){
 	pwmInit.TIM_OutputState = TIM_OutputState_Enable;
 
 	TIM_OC1Init(TIM4, &pwmInit);
+	TIM_DMACmd(TIM4, TIM_DMA_CC1, ENABLE);
 }
 
 static void Start_DMA(void){
 	TIM_Cmd(TIM4,DISABLE);
-	DMA_Cmd(DMA1_Channel1,DISABLE);
+	DMA_Cmd(WS2812_DMA,DISABLE);
 	TIM4->CNT = 0;
-	DMA_SetCurrDataCounter(DMA1_Channel1,sizeof(dmaBuffer));
+	TIM4->CCMR1 = (TIM4->CCMR1 & ~TIM_CCMR1_OC1M) | TIM_OCMode_PWM1;   // release the forced low
+	DMA_SetCurrDataCounter(WS2812_DMA,dmaTransferSize);
 	TIM_Cmd(TIM4,ENABLE);
-	DMA_Cmd(DMA1_Channel1,ENABLE);
+	DMA_Cmd(WS2812_DMA,ENABLE);
+
+	if(tailStarted){
+		Start_LatchTimer();
+	}
+}
+
+// holds the pin low while TIM4 is stopped
+static void Stop_Output(void){
+	TIM_ForcedOC1Config(TIM4,TIM_ForcedAction_InActive);
+	TIM_Cmd(TIM4,DISABLE);
+	DMA_Cmd(WS2812_DMA,DISABLE);
+}
+
+#endif
+
+#if POWER_SUMS
+// adds (weight > 0) or removes (weight < 0) |weight| back buffer pixels of this color from the channel sums
+static inline void Power_Account(tFramePixel const *pixel, int32_t weight){
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	paletteCount[*pixel] += (uint16_t)weight;
+#elif WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+	tPixel color;
+	Expand_Rgb565(*pixel,&color);
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		powerSums[k] += (uint32_t)((int32_t)color.c[k] * weight);
+	}
+#else
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		powerSums[k] += (uint32_t)((int32_t)pixel->c[k] * weight);
+	}
+#endif
+}
+
+// leds of the back buffer span which are in the sums, the ones above the last refresh get added once a
+// refresh includes them
+static inline uint32_t Power_Counted(tFramePixel const *pixels, uint32_t numLeds){
+	uint32_t first = (uint32_t)(pixels - rgbBuffer[nextRGBIdx]);
+	if(first >= powerLeds){
+		return 0;
+	}
+	return (numLeds < powerLeds - first) ? numLeds : powerLeds - first;
+}
+
+static inline void Power_AccountSpan(tFramePixel const *pixels, uint32_t numLeds, int32_t weight){
+	numLeds = Power_Counted(pixels,numLeds);
+	for(uint32_t i = 0; i<numLeds; ++i){
+		Power_Account(&pixels[i],weight);
+	}
+}
+#endif
+
+#if WS2812_POWER_LIMIT
+// estimates the current of the back buffer and scales the correction table down to the budget
+static void Limit_Power(void){
+#if WS2812_RLE
+	// walks the runs, a fill run counts its color once
+	uint32_t powerSums[CHANNELS] = {0};
+	tRGB_Buffer const *frame = &rgbBuffer[nextRGBIdx];
+	uint32_t left = lednumInput;
+	uint32_t color = 0;
+	tPixel expanded;
+
+	for(uint32_t run = 0; run<frame->runs && left != 0; ++run){
+		uint32_t count = frame->counts[run] & RLE_MAX_COUNT;
+		uint32_t leds = (count < left) ? count : left;
+		uint8_t literal = (frame->counts[run] & RLE_LITERAL) != 0;
+
+		for(uint32_t i = 0; i<(literal ? leds : 1); ++i){
+			tPixel const *pixel = Stored_Color(nextRGBIdx,&frame->colors[color + i],&expanded);
+			for(uint32_t k = 0; k<CHANNELS; ++k){
+				powerSums[k] += (literal ? 1 : leds) * pixel->c[k];
+			}
+		}
+		color += literal ? count : 1;
+		left -= leds;
+	}
+	tPixel const *blank = Stored_Color(nextRGBIdx,&rleBlank,&expanded);
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		powerSums[k] += left * blank->c[k];
+	}
+#else
+	if(powerRecount){
+		powerRecount = 0;
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+		memset(paletteCount,0,sizeof(paletteCount));
+#else
+		memset(powerSums,0,sizeof(powerSums));
+#endif
+		powerLeds = 0;
+	}
+
+	// move the end of the sums to the refreshed count, only the leds in between get walked
+	if(lednumInput > powerLeds){
+		uint32_t first = powerLeds;
+		powerLeds = lednumInput;
+		Power_AccountSpan(&rgbBuffer[nextRGBIdx][first],lednumInput - first,1);
+	}
+	else{
+		Power_AccountSpan(&rgbBuffer[nextRGBIdx][lednumInput],powerLeds - lednumInput,-1);
+		powerLeds = lednumInput;
+	}
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	uint32_t powerSums[CHANNELS] = {0};
+	for(uint32_t i = 0; i<256; ++i){
+		for(uint32_t k = 0; k<CHANNELS; ++k){
+			powerSums[k] += (uint32_t)paletteCount[i] * palette[nextRGBIdx][i].c[k];
+		}
+	}
+#endif
+#endif
+
+	uint64_t channelUa = 0;
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		// the white balance and brightness scale the channels, the gamma curve only lowers them further
+		channelUa += ((uint64_t)powerSums[k] * powerUa[k] * whiteBalance[k] * brightness) / ((uint64_t)PIXEL_MAX * 65025);
+	}
+	if(lednumInput != 0 && lednumToTransmit != lednumInput){
+		channelUa = (channelUa * lednumToTransmit) / lednumInput;    // remapped or scaled strip, average per refreshed led
+	}
+	uint64_t idleUa = (uint64_t)powerIdleUa * lednumToTransmit;
+
+	powerEstimateMa = (uint32_t)((channelUa + idleUa + 999) / 1000);
+
+	uint16_t scale = 256;
+	if(powerBudgetMa != 0 && powerEstimateMa > powerBudgetMa){
+		uint64_t budgetUa = (uint64_t)powerBudgetMa * 1000;
+		scale = (budgetUa > idleUa) ? (uint16_t)(((budgetUa - idleUa) * 256) / channelUa) : 0;
+	}
+
+	if(scale != powerScale){
+		powerScale = scale;
+		Fill_CorrectionLut();    // gets swapped in with the frame
+	}
+}
+#endif
+
+#if WS2812_RLE
+// prepares the back buffer for a write at led first: led 0 starts the frame over, a gap up to first gets filled
+// with leds of the value 0. Leds below the end of the frame can't be changed anymore
+static uint8_t Rle_Seat(uint32_t first){
+	tRGB_Buffer *frame = &rgbBuffer[nextRGBIdx];
+
+	if(first == 0){
+		frame->runs = 0;
+		frame->used = 0;
+		frame->leds = 0;
+	}
+	if(first < frame->leds){
+		rleDrops++;
+		return 0;
+	}
+	return (first == frame->leds) || Rle_Fill(rleBlank,first - frame->leds);
+}
+
+// appends leds of one color to the back buffer: the last run grows if it has the color, a single led goes into a
+// literal run. Returns 0 if the runs or colors ran out, the leds which didn't fit get dropped
+static uint8_t Rle_Fill(tFramePixel value, uint32_t numLeds){
+	tRGB_Buffer *frame = &rgbBuffer[nextRGBIdx];
+
+	while(numLeds != 0){
+		uint16_t *last = &frame->counts[(frame->runs != 0) ? frame->runs - 1 : 0];
+		uint8_t same = (frame->runs != 0) && (memcmp(&frame->colors[frame->used - 1],&value,sizeof(value)) == 0);
+
+		if(same && !(*last & RLE_LITERAL) && *last < RLE_MAX_COUNT){
+			uint32_t leds = RLE_MAX_COUNT - *last;
+			leds = (numLeds < leds) ? numLeds : leds;
+			*last = (uint16_t)(*last + leds);
+			frame->leds += leds;
+			numLeds -= leds;
+		}
+		else if(same && (*last & RLE_LITERAL)){
+			// the last led of the literal run becomes a fill run, it grows in the next pass
+			if(*last == (RLE_LITERAL | 1)){
+				*last = 1;
+			}
+			else if(frame->runs < WS2812_RLE_RUNS){
+				(*last)--;
+				frame->counts[frame->runs++] = 1;
+			}
+			else{
+				break;
+			}
+		}
+		else if(frame->used == WS2812_RLE_COLORS){
+			break;
+		}
+		else if(numLeds == 1 && frame->runs != 0 && (*last & RLE_LITERAL) && *last < (RLE_LITERAL | RLE_MAX_COUNT)){
+			(*last)++;
+			frame->colors[frame->used++] = value;
+			frame->leds++;
+			numLeds = 0;
+		}
+		else if(frame->runs < WS2812_RLE_RUNS){
+			// a literal run for a single led, otherwise an empty fill run which grows in the next pass
+			frame->counts[frame->runs++] = (numLeds == 1) ? (RLE_LITERAL | 1) : 0;
+			frame->colors[frame->used++] = value;
+			if(numLeds == 1){
+				frame->leds++;
+				numLeds = 0;
+			}
+		}
+		else{
+			break;
+		}
+	}
+
+	if(numLeds != 0){
+		rleDrops++;
+		return 0;
+	}
+	return 1;
+}
+
+// stored pixel of a framebuffer led, searched from the first run
+static tFramePixel const *Rle_Find(uint8_t buffer, uint32_t led){
+	tRGB_Buffer const *frame = &rgbBuffer[buffer];
+	uint32_t color = 0;
+
+	if(led >= frame->leds){
+		return &rleBlank;
+	}
+	for(uint32_t run = 0; run<frame->runs; ++run){
+		uint32_t count = frame->counts[run] & RLE_MAX_COUNT;
+		uint8_t literal = (frame->counts[run] & RLE_LITERAL) != 0;
+		if(led < count){
+			return &frame->colors[color + (literal ? led : 0)];
+		}
+		led -= count;
+		color += literal ? count : 1;
+	}
+	return &rleBlank;
+}
+
+// copies the runs in use
+static void Rle_Copy(tRGB_Buffer *dst, tRGB_Buffer const *src){
+	memcpy(dst->counts,src->counts,src->runs * sizeof(src->counts[0]));
+	memcpy(dst->colors,src->colors,src->used * sizeof(src->colors[0]));
+	dst->runs = src->runs;
+	dst->used = src->used;
+	dst->leds = src->leds;
+}
+#endif
+
+#if WS2812_SINGLE_BUFFER
+// counts a write into framebuffer leds which the encoder still has to read for the frame on the wire
+static inline void Check_Tear(uint32_t first, uint32_t numLeds){
+	if(!transferRunning || first >= lednumInput){
+		return;
+	}
+
+	uint32_t pending = currentLEDIdx;    /**< first framebuffer led which hasn't been encoded yet */
+#if WS2812_REMAP
+	if(remapLength != 0){
+		pending = 0;      // the remap can still send any led
+	}
+#endif
+#if WS2812_SCALING
+	if(scaleLength != 0 && pending != 0){
+		pending = (uint32_t)((((uint64_t)pending * scaleStep) + scaleOffset) >> 16);   // linear mode reads the next one too
+	}
+#endif
+	if(pending < lednumInput && first + numLeds > pending){
+		tearCount++;
+	}
+}
+#endif
+
+// the output changed without a new frame, the next refresh has to be sent even if it's a duplicate
+static void Invalidate_LastFrame(void){
+#if WS2812_DEDUP
+	lastFrameValid = 0;
+#endif
+}
+
+#if WS2812_DEDUP
+// feeds a block into the crc unit, the last word is padded with zeros
+static void Crc_Block(void const *block, uint32_t length){
+	uint8_t const *data = (uint8_t const *)block;
+	uint32_t word;
+
+	while(length >= 4){
+		memcpy(&word,data,4);
+		CRC_CalcCRC(word);
+		data += 4;
+		length -= 4;
+	}
+	if(length != 0){
+		word = 0;
+		memcpy(&word,data,length);
+		CRC_CalcCRC(word);
+	}
+}
+
+// crc of the led count and the pixels (and the palette) of a framebuffer with the crc unit
+static uint32_t Frame_Crc(uint8_t buffer, uint32_t numLeds){
+	CRC_ResetDR();
+	CRC_CalcCRC(numLeds);
+#if WS2812_RLE
+	Crc_Block(rgbBuffer[buffer].counts,rgbBuffer[buffer].runs * sizeof(uint16_t));
+	Crc_Block(rgbBuffer[buffer].colors,rgbBuffer[buffer].used * sizeof(tFramePixel));
+#else
+	Crc_Block(rgbBuffer[buffer],numLeds * sizeof(tFramePixel));
+#endif
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	Crc_Block(palette[buffer],sizeof(palette[buffer]));
+#endif
+	return CRC_GetCRC();
+}
+#endif
+
+// leds to send: the remap, the scaled strip or the refreshed leds
+static void Update_OutputLength(void){
+	lednumToTransmit = lednumInput;
+
+#if WS2812_SCALING
+	if(scaleLength != 0){
+		lednumToTransmit = scaleLength;
+		if(scaleMode == WS2812_SCALE_NEAREST){
+			// centre of each scaled led
+			scaleStep = (lednumInput << 16) / scaleLength;
+			scaleOffset = scaleStep / 2;
+		}
+		else{
+			// first and last led stay in place, the others get interpolated
+			scaleStep = (lednumInput > 1 && scaleLength > 1) ? ((lednumInput - 1) << 16) / (scaleLength - 1) : 0;
+			scaleOffset = 0;
+		}
+	}
+#endif
+
+#if WS2812_REMAP
+	if(remapLength != 0){
+		lednumToTransmit = remapLength;
+	}
+#endif
+}
+
+static void Start_Frame(void){
+	transferRunning = 1;
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+	// bit reversed frame counter: every threshold once within 256 frames, well spread
+	frameCounter++;
+	ditherBase = (uint8_t)(__RBIT(frameCounter) >> 24);
+#endif
+#if WS2812_SMOOTHING
+	smoothingMoved = 0;
+#endif
+#if WS2812_INTERPOLATION
+	outputFrames++;
+	blendPos = (blendPos + blendStep < 256) ? (uint16_t)(blendPos + blendStep) : 256;
+#endif
+	currentLEDIdx = 0;
+#if WS2812_RLE
+	rleLed = 0;
+	rleRun = 0;
+	rleLeft = 0;
+	rleColor = 0;
+#endif
+	tailStarted = 0;
+	tailBits = 0;
+#if WS2812_REMAP
+	runIdx = 0;
+	runLeft = 0;
+	runRepeat = 0;
+#endif
+#if WS2812_FULL_FRAME
+	Encode_Frame();
+#else
+	Setup_DMA_Buffer(0);
+	Setup_DMA_Buffer(1);
+#endif
+
+	// during the latch gap the frame stays armed until TIM3 ends the gap
+	NVIC_DisableIRQ(TIM3_IRQn);
+	if(gapActive){
+		frameArmed = 1;
+	}
+	else{
+		Start_DMA();
+	}
+	NVIC_EnableIRQ(TIM3_IRQn);
+}
+
+// claims the idle output for a frame start, returns 0 if a frame is running or starting. Only the check and the
+// claim need the interrupts off, the frame gets encoded after it (a refresh meanwhile becomes pending)
+static uint8_t Claim_Output(void){
+	__disable_irq();
+	uint8_t idle = !transferRunning;
+	transferRunning = 1;
+	__enable_irq();
+	return idle;
+}
+
+// waits until the output is idle (withGap: and the latch gap is over) and returns with the interrupts off, so
+// a refresh from an isr can't start a frame while the caller changes what the encoder reads. The caller
+// enables them again right after the update. Repeats of the running frame end early meanwhile
+static void Hold_Output(uint8_t withGap){
+	refreshRequested = 1;
+	while(1){
+		while(transferRunning || (withGap && gapActive)){
+			WS2812_WAIT();
+		}
+		__disable_irq();
+		if(!transferRunning && !(withGap && gapActive)){
+			break;
+		}
+		__enable_irq();    // an isr refresh claimed the output in between
+	}
+	refreshRequested = 0;
+}
+
+// makes the back buffer the frame on the wire and starts it, the output has to be claimed (transferRunning)
+// by the caller: the refresh or the latch isr with a pending refresh
+static void Commit_Frame(uint32_t numLeds){
+	if(numLeds > MAX_LED_NUM){
+		lednumInput = MAX_LED_NUM;
+	}
+	else{
+		lednumInput = numLeds;
+	}
+	Update_OutputLength();
+#if WS2812_POWER_LIMIT
+	Limit_Power();
+#endif
+
+#if WS2812_INTERPOLATION
+	// fade over 3/4 of the frames which fitted between the last refreshes: a frame which arrives a bit early
+	// finds the fade completed instead of cutting it off at the displayed blend
+	if(outputFrames > MAX_BLEND_FRAMES){
+		outputFrames = MAX_BLEND_FRAMES;
+	}
+	framesPerInput = (uint32_t)((int32_t)framesPerInput + (((int32_t)(outputFrames << 8) - (int32_t)framesPerInput) / 4));
+	uint32_t blendFrames = (framesPerInput * BLEND_SHARE) >> 8;     /**< 8.8 fixed point */
+	blendStep = (blendFrames > 256) ? (uint16_t)(65536 / blendFrames) : 256;
+	blendPos = 0;
+	outputFrames = 0;
+
+	uint8_t tmp = previousRGBIdx;
+	previousRGBIdx = currentRGBIdx;
+	currentRGBIdx = nextRGBIdx;
+	nextRGBIdx = tmp;
+#elif !WS2812_SINGLE_BUFFER
+	uint8_t tmp = currentRGBIdx;
+	currentRGBIdx = nextRGBIdx;
+	nextRGBIdx = tmp;
+#endif
+
+	// the copy comes first: a short frame could end and commit the next refresh during it
+#if WS2812_RLE
+	Rle_Copy(&rgbBuffer[nextRGBIdx],&rgbBuffer[currentRGBIdx]);
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	memcpy(palette[nextRGBIdx],palette[currentRGBIdx],sizeof(palette[0]));
+#endif
+#elif !WS2812_SINGLE_BUFFER
+	memcpy(rgbBuffer[nextRGBIdx],rgbBuffer[currentRGBIdx],sizeof(tRGB_Buffer));
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE
+	memcpy(palette[nextRGBIdx],palette[currentRGBIdx],sizeof(palette[0]));
+#endif
+#endif
+
+	Swap_CorrectionLut();
+	frameFresh = 1;
+	Start_Frame();
+}
+
+// integer square root of a 64 bit value
+static uint32_t Isqrt(uint64_t x){
+	uint64_t result = 0;
+	uint64_t bit = 1ull << 62;
+
+	while(bit > x){
+		bit >>= 2;
+	}
+	while(bit != 0){
+		if(x >= result + bit){
+			x -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)result;
+}
+
+// x^(gamma/4096) with x in 16.16 fixed point (0 ... 1.0)
+static uint32_t Pow_Q16(uint32_t x, uint32_t gammaQ12){
+	uint64_t result = 0x10000;
+	uint64_t root = x;
+
+	for(uint32_t i = 0; i < (gammaQ12 >> 12); ++i){
+		result = (result * x) >> 16;
+	}
+	// fractional part: multiply with x^(1/2), x^(1/4), ...
+	for(int32_t bit = 11; bit >= 0; --bit){
+		root = Isqrt(root << 16);
+		if(gammaQ12 & (1u << bit)){
+			result = (result * root) >> 16;
+		}
+	}
+	return (uint32_t)result;
+}
+
+static void Build_GammaCurve(void){
+	uint32_t gammaQ12 = ((uint32_t)gammaValue * 4096 + 50) / 100;
+
+	for(uint32_t i = 0; i<256; ++i){
+		uint32_t x = (i * 0x10000 + 127) / 255;
+		gammaCurve[i] = (uint16_t)((Pow_Q16(x,gammaQ12) * 255 + 0x80) >> 8);
+	}
+}
+
+// builds the inactive table, gets used with the next frame. A call from an isr (the power limit of a refresh)
+// during a build of the thread only tells the running build to start over, the table stays inactive meanwhile
+static void Fill_CorrectionLut(void){
+	__disable_irq();
+	if(lutBuilding){
+		lutRebuild = 1;
+		__enable_irq();
+		return;
+	}
+	lutBuilding = 1;
+	__enable_irq();
+
+	uint8_t (*lut)[257] = correctionLut[activeLut ^ 1];    // no swap while building
+	while(1){
+		lutRebuild = 0;
+		for(uint32_t c = 0; c<CHANNELS; ++c){
+			// brightness * white balance in 16.16 fixed point
+			uint32_t scale = ((uint32_t)brightness * whiteBalance[c] * 0x10000 + 32512) / 65025;
+#if WS2812_POWER_LIMIT
+			scale = (scale * powerScale) >> 8;
+#endif
+			for(uint32_t i = 0; i<256; ++i){
+				lut[c][i] = (uint8_t)((gammaCurve[i] * scale + 0x800000) >> 24);
+			}
+			lut[c][256] = lut[c][255];
+		}
+
+		__disable_irq();
+		if(!lutRebuild){
+			lutPending = 1;
+			lutBuilding = 0;
+			__enable_irq();
+			return;
+		}
+		__enable_irq();
+	}
+}
+
+static void Build_CorrectionLut(void){
+	Fill_CorrectionLut();
+
+	// nothing gets sent at the moment, show the current frame with the new table
+	if((lednumToTransmit != 0) && Claim_Output()){
+		Swap_CorrectionLut();
+		frameFresh = 1;
+		Start_Frame();
+	}
+}
+
+static void Swap_CorrectionLut(void){
+	if(lutPending && !lutBuilding){
+		activeLut ^= 1;
+		lutPending = 0;
+	}
+}
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+// corrects a 16 bit channel (interpolated between the table entries) and dithers it to 8 bit
+static inline uint8_t Dither_Channel(uint8_t const *lut, uint16_t value, uint8_t threshold){
+	uint32_t hi = value >> 8;
+	uint32_t lo = value & 0xFF;
+	uint32_t corrected = (lut[hi] << 8) + (lut[hi+1] - lut[hi]) * lo;   // max 255 << 8
+
+	return (uint8_t)((corrected + threshold) >> 8);
+}
+#endif
+
+#if WS2812_RGBW && WS2812_WHITE_EXTRACTION
+// moves min(r,g,b) to the white channel of a pixel without white, compiles to a few conditional moves
+static inline void Extract_White(uint8_t wire[CHANNELS]){
+	uint32_t white = wire[WIRE_R];
+	white = (wire[WIRE_G] < white) ? wire[WIRE_G] : white;
+	white = (wire[WIRE_B] < white) ? wire[WIRE_B] : white;
+
+	wire[WIRE_R] -= white;
+	wire[WIRE_G] -= white;
+	wire[WIRE_B] -= white;
+	wire[WIRE_W] = (uint8_t)white;
+}
+#endif
+
+// returns the corrected bytes of the led which gets sent next in wire order
+#if WS2812_REMAP
+// framebuffer led of the output led, the leds are requested in order
+static inline uint32_t Remap_Led(uint32_t ledIdx){
+	if(remapTable != 0){
+		return remapTable[ledIdx];
+	}
+	if(remapRuns == 0){
+		return ledIdx;
+	}
+
+	if(runLeft == 0){
+		tWS2812_Run const *run;
+		if(runRepeat == 0){     // next run
+			run = &remapRuns[runIdx++];
+			runRepeat = (run->repeat != 0) ? run->repeat : 1;
+		}
+		else{                   // next repetition
+			run = &remapRuns[runIdx - 1];
+		}
+		runRepeat--;
+		runLeft = run->count;
+		runLed = run->start;
+	}
+	uint32_t led = (uint32_t)runLed;
+	runLed += remapRuns[runIdx - 1].step;
+	runLeft--;
+	return led;
+}
+#endif
+
+#if WS2812_RLE
+// stored pixel of a led of the frame on the wire: the next one in order continues in the runs,
+// another one (or one above the runs) gets searched
+static inline tFramePixel const *Rle_Next(uint32_t led){
+	tRGB_Buffer const *frame = &rgbBuffer[currentRGBIdx];
+
+	if(led != rleLed || led >= frame->leds){
+		return Rle_Find(currentRGBIdx,led);
+	}
+	uint16_t count = frame->counts[rleRun];
+	if(rleLeft == 0){
+		rleLeft = count & RLE_MAX_COUNT;
+	}
+
+	tFramePixel const *stored = &frame->colors[rleColor];
+	rleLed++;
+	rleLeft--;
+	if(rleLeft == 0 || (count & RLE_LITERAL)){
+		rleColor++;
+	}
+	if(rleLeft == 0){
+		rleRun++;
+	}
+	return stored;
+}
+#endif
+
+// framebuffer led of the frame on the wire, crossfaded into blended while interpolating
+static inline tPixel const *Frame_Pixel(uint32_t led, tPixel *blended){
+#if WS2812_RLE
+	return Stored_Color(currentRGBIdx,Rle_Next(led),blended);
+#else
+	tPixel const *current = Led_Color(currentRGBIdx,led,blended);
+#if WS2812_INTERPOLATION
+	if(blendPos < 256){
+		tPixel expanded;
+		tPixel const *previous = Led_Color(previousRGBIdx,led,&expanded);
+		for(uint32_t k = 0; k<CHANNELS; ++k){
+			blended->c[k] = (uint16_t)(previous->c[k] + ((((int32_t)current->c[k] - previous->c[k]) * blendPos) >> 8));
+		}
+		return blended;
+	}
+#endif
+	return current;
+#endif
+}
+
+#if WS2812_SCALING
+// pixel of the scaled strip, the two nearest framebuffer leds get mixed into mixed in linear mode
+static inline tPixel const *Scale_Pixel(uint32_t led, tPixel *mixed){
+	uint32_t pos = (uint32_t)((((uint64_t)led * scaleStep) + scaleOffset) >> 8);   /**< 24.8 fixed point */
+	tPixel const *a = Frame_Pixel(pos >> 8,mixed);
+	int32_t weight = (int32_t)(pos & 0xFF);
+
+	if(scaleMode == WS2812_SCALE_NEAREST || weight == 0){
+		return a;
+	}
+
+	tPixel next;
+	tPixel const *b = Frame_Pixel((pos >> 8) + 1,&next);    // a isn't the last led, its position would be exact
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		mixed->c[k] = (uint16_t)(a->c[k] + ((((int32_t)b->c[k] - a->c[k]) * weight) >> 8));
+	}
+	return mixed;
 }
+#endif
 
+// framebuffer pixel of the output led
+static inline tPixel const *Source_Pixel(uint32_t ledIdx, tPixel *mixed){
+	uint32_t led = ledIdx;
+#if WS2812_REMAP
+	led = Remap_Led(ledIdx);
+#endif
+
+#if WS2812_SCALING
+	if(scaleLength != 0){
+		if(led >= scaleLength || lednumInput == 0){
+			return &darkPixel;
+		}
+		return Scale_Pixel(led,mixed);
+	}
+#endif
+#if WS2812_REMAP || WS2812_SCALING
+	if(led >= lednumInput){
+		return &darkPixel;
+	}
+#endif
+	return Frame_Pixel(led,mixed);
+}
+
+#if WS2812_SMOOTHING
+// filtered pixel of the output led: the state moves by smoothGain / 256 of the distance, at least one step
+static inline tPixel const *Smooth_Pixel(uint32_t ledIdx, tPixel const *pixel, tPixel *smoothed){
+	if(smoothGain >= 256 || ledIdx >= MAX_LED_NUM){
+		return pixel;
+	}
+
+	uint16_t *state = smoothState[ledIdx];
+	int32_t moved = 0;
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		int32_t diff = (int32_t)TO_SMOOTH(pixel->c[k]) - state[k];
+		int32_t step = (diff * smoothGain) >> 8;
+		if(step == 0 && diff != 0){
+			step = (diff > 0) ? 1 : -1;
+		}
+		uint16_t next = (uint16_t)(state[k] + step);
+		if(FROM_SMOOTH(next) == pixel->c[k]){
+			next = TO_SMOOTH(pixel->c[k]);    // settled, the rest would only move below the output resolution
+		}
+		moved |= next ^ state[k];
+		state[k] = next;
+		smoothed->c[k] = FROM_SMOOTH(next);
+	}
+	if(moved != 0){
+		smoothingMoved = 1;
+	}
+	return smoothed;
+}
+#endif
+
+static inline void Get_Pixel(uint32_t ledIdx, uint8_t wire[CHANNELS]){
+	uint8_t const (*lut)[257] = correctionLut[activeLut];
+	tPixel mixed;
+	tPixel const *pixel = Source_Pixel(ledIdx,&mixed);
+#if WS2812_SMOOTHING
+	tPixel smoothed;
+	pixel = Smooth_Pixel(ledIdx,pixel,&smoothed);
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+	uint8_t threshold = (uint8_t)(ditherBase + ledIdx * DITHER_SPREAD);
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		wire[k] = Dither_Channel(lut[k],pixel->c[k],threshold);
+	}
+#else
+	for(uint32_t k = 0; k<CHANNELS; ++k){
+		wire[k] = lut[k][pixel->c[k]];
+	}
+#endif
+
+#if WS2812_RGBW && WS2812_WHITE_EXTRACTION
+	// only rgb colors, explicit rgbw colors get sent as set
+	if(pixel->c[WIRE_W] == 0){
+		Extract_White(wire);
+	}
+#endif
+}
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+#define SPI_BIT(n,b)       (4 | ((((n) >> (b)) & 1) << 1))
+#define SPI_NIBBLE(n)      ((SPI_BIT(n,3) << 9) | (SPI_BIT(n,2) << 6) | (SPI_BIT(n,1) << 3) | SPI_BIT(n,0))
+
+static uint16_t const spiNibble[16] = {
+	SPI_NIBBLE(0),  SPI_NIBBLE(1),  SPI_NIBBLE(2),  SPI_NIBBLE(3),
+	SPI_NIBBLE(4),  SPI_NIBBLE(5),  SPI_NIBBLE(6),  SPI_NIBBLE(7),
+	SPI_NIBBLE(8),  SPI_NIBBLE(9),  SPI_NIBBLE(10), SPI_NIBBLE(11),
+	SPI_NIBBLE(12), SPI_NIBBLE(13), SPI_NIBBLE(14), SPI_NIBBLE(15),
+};
+
+// expands one byte into 24 spi bits (msb first) with two table lookups
+static inline uint8_t *Encode_Byte(uint8_t *dst, uint32_t value){
+	uint32_t bits = ((uint32_t)spiNibble[value >> 4] << 12) | spiNibble[value & 0xF];
+
+	dst[0] = (uint8_t)(bits >> 16);
+	dst[1] = (uint8_t)(bits >> 8);
+	dst[2] = (uint8_t)bits;
+	return dst + 3;
+}
+#else
+// expands one byte into 8 duty cycles (msb first) without branches
+static inline uint8_t *Encode_Byte(uint8_t *dst, uint32_t value){
+	for(int32_t bit = 7; bit >= 0; --bit){
+		*dst++ = (uint8_t)(dutyT0H + ((value >> bit) & 1) * dutyDiff);
+	}
+	return dst;
+}
+#endif
+
+#if WS2812_FULL_FRAME
+// encodes all leds in one go, the dma sends them without refills
+static void Encode_Frame(void){
+	uint8_t *dmaBufferPos = dmaBuffer;
+	uint8_t wire[CHANNELS];
+
+	for(uint32_t i = 0; i<lednumToTransmit; ++i){
+		Get_Pixel(i,wire);
+		for(uint32_t k = 0; k<CHANNELS; ++k){
+			dmaBufferPos = Encode_Byte(dmaBufferPos,wire[k]);
+		}
+	}
+	*dmaBufferPos++ = 0;     // pulls the line low after the last bit
+
+	currentLEDIdx = lednumToTransmit;
+	dmaTransferSize = (uint32_t)(dmaBufferPos - dmaBuffer);
+}
+#else
+static void Refill_DMA_Buffer(uint8_t bufferPos){
+	if(tailStarted){
+		return;     // only zeros left, TIM3 stops the dma
+	}
+
+	Setup_DMA_Buffer(bufferPos);
+
+	if(tailStarted){
+		Start_LatchTimer();
+	}
+}
 
 static void Setup_DMA_Buffer(uint8_t bufferPos){
 	uint8_t *dmaBufferPos = dmaBuffer;
@@ -232,26 +2234,30 @@ static void Setup_DMA_Buffer(uint8_t bufferPos){
 		dmaBufferPos = dmaBuffer + sizeof(dmaBuffer)/2;
 	}
 
-	if(currentLEDIdx<lednumToTransmit){
-		tWS2812_RGB color = rgbBuffer[currentRGBIdx][currentLEDIdx];
+	// all leds are in the buffer, zeros pull the line low for the latch. A repeat ends early for a new frame
+	if(currentLEDIdx >= lednumToTransmit || (!frameFresh && (refreshPending || refreshRequested))){
+		memset(dmaBufferPos,0,sizeof(dmaBuffer)/2);
+		tailStarted = 1;
+		return;
+	}
 
-		for(uint8_t i = 0x80; i!=0; i>>=1){
-			(*dmaBufferPos) = (color.g & i) ? WS2812_T1H : WS2812_T0H;
-			dmaBufferPos++;
-		}
-		for(uint8_t i = 0x80; i!=0; i>>=1){
-			(*dmaBufferPos) = (color.r & i) ? WS2812_T1H : WS2812_T0H;
-			dmaBufferPos++;
+	tailBits = 0;
+	for(uint32_t n = 0; n<LEDS_PER_HALF; ++n){
+		if(currentLEDIdx<lednumToTransmit){
+			uint8_t wire[CHANNELS];
+			Get_Pixel(currentLEDIdx,wire);
+
+			for(uint32_t k = 0; k<CHANNELS; ++k){
+				dmaBufferPos = Encode_Byte(dmaBufferPos,wire[k]);
+			}
+
+			currentLEDIdx++;
+			tailBits += BITS_PER_LED;
 		}
-		for(uint8_t i = 0x80; i!=0; i>>=1){
-			(*dmaBufferPos) = (color.b & i) ? WS2812_T1H : WS2812_T0H;
-			dmaBufferPos++;
+		else{
+			memset(dmaBufferPos,0,DMA_BYTE_PER_LED);
+			dmaBufferPos += DMA_BYTE_PER_LED;
 		}
-
-		currentLEDIdx++;
-	}
-	else{ // initialize reset pulse
-		memset(dmaBufferPos,cResetPulseValue,BYTE_PER_LED);
-		++resetPulseIdx;
 	}
 }
+#endif
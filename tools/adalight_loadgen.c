@@ -0,0 +1,346 @@
+/**
+  ******************************************************************************
+  * @file    adalight_loadgen.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Linux load generator for the Adalight slave
+  *
+  * Streams Adalight frames with a given led count, rate and content pattern
+  * to a serial device (a real /dev/ttyUSBx or the pty of adalight_pty_slave).
+  * The first led carries a 16 bit frame sequence number (g = high, r = low
+  * byte, b = 0xA5). If the other side echoes "F<seq>\n" per frame (only
+  * adalight_pty_slave does) the frame loss and the latency get reported too.
+  *
+  * Build: gcc -O2 -o adalight_loadgen tools/adalight_loadgen.c
+  ******************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/select.h>
+
+#define MAX_LEDS      (0xFFFF)
+#define SEQ_MARKER    (0xA5)
+
+typedef enum{
+	Pattern_Solid,Pattern_Ramp,Pattern_Rainbow,Pattern_Random,
+}tPattern;
+
+typedef struct{
+	char const *device;
+	uint32_t    baud;
+	uint32_t    leds;
+	double      fps;          /**< 0 ... as fast as possible */
+	double      duration;     /**< seconds */
+	tPattern    pattern;
+	int         waitGreeting;
+}tOptions;
+
+typedef struct{
+	uint64_t framesSent;
+	uint64_t framesLate;
+	uint64_t bytesSent;
+	uint64_t framesEchoed;
+	double   latencyMin;
+	double   latencyMax;
+	double   latencySum;
+}tStats;
+
+static double sendTime[0x10000];   /**< send timestamp per sequence number */
+
+static double Now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static speed_t BaudToSpeed(uint32_t baud){
+	switch(baud){
+		case 9600:    return B9600;
+		case 57600:   return B57600;
+		case 115200:  return B115200;
+		case 230400:  return B230400;
+		case 460800:  return B460800;
+		case 500000:  return B500000;
+		case 921600:  return B921600;
+		case 1000000: return B1000000;
+		default:      return 0;
+	}
+}
+
+static int OpenDevice(tOptions const *opt){
+	int fd = open(opt->device,O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(fd < 0){
+		perror(opt->device);
+		return -1;
+	}
+
+	struct termios tio;
+	if(tcgetattr(fd,&tio) == 0){
+		cfmakeraw(&tio);
+		speed_t speed = BaudToSpeed(opt->baud);
+		if(speed == 0){
+			fprintf(stderr,"unsupported baud rate %u\n",opt->baud);
+			close(fd);
+			return -1;
+		}
+		cfsetispeed(&tio,speed);
+		cfsetospeed(&tio,speed);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tcsetattr(fd,TCSANOW,&tio);
+	}
+
+	// writes block, reads are polled
+	fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) & ~O_NONBLOCK);
+	// drop what the slave sent before (its greeting), -w waits for a fresh one
+	tcflush(fd,TCIFLUSH);
+	return fd;
+}
+
+static int WaitReadable(int fd, double timeout){
+	fd_set set;
+	FD_ZERO(&set);
+	FD_SET(fd,&set);
+	struct timeval tv;
+	tv.tv_sec = (time_t)timeout;
+	tv.tv_usec = (suseconds_t)((timeout - tv.tv_sec)*1e6);
+	return select(fd+1,&set,0,0,&tv) > 0;
+}
+
+static int WaitGreeting(int fd, double timeout){
+	char const *greeting = "Ada";
+	uint32_t matched = 0;
+	double end = Now() + timeout;
+
+	while(Now() < end){
+		if(!WaitReadable(fd,0.01)){
+			continue;
+		}
+		char ch;
+		if(read(fd,&ch,1) == 1){
+			matched = (ch == greeting[matched]) ? matched+1 : (ch == greeting[0]);
+			if(greeting[matched] == 0){
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void BuildFrame(uint8_t *frame, tOptions const *opt, uint16_t seq){
+	uint32_t leds = opt->leds;
+	uint8_t *pos = frame;
+
+	*pos++ = 'A';
+	*pos++ = 'd';
+	*pos++ = 'a';
+	*pos++ = (uint8_t)(leds>>8);
+	*pos++ = (uint8_t)(leds);
+	*pos++ = ((uint8_t)(leds>>8)) ^ ((uint8_t)(leds)) ^ 0x55;
+
+	// sequence number in the first led (slave order is g,r,b)
+	*pos++ = (uint8_t)(seq>>8);
+	*pos++ = (uint8_t)(seq);
+	*pos++ = SEQ_MARKER;
+
+	for(uint32_t i = 1; i<leds; ++i){
+		uint8_t r,g,b;
+		switch(opt->pattern){
+			case Pattern_Solid:{
+				r = g = b = (uint8_t)seq;
+			}break;
+			case Pattern_Ramp:{
+				r = g = b = (uint8_t)((i*256)/leds + seq);
+			}break;
+			case Pattern_Rainbow:{
+				uint8_t h = (uint8_t)((i*256)/leds + seq);
+				uint8_t x = (uint8_t)((h % 85) * 3);
+				if(h < 85){ r = 255-x; g = x; b = 0; }
+				else if(h < 170){ r = 0; g = 255-x; b = x; }
+				else{ r = x; g = 0; b = 255-x; }
+			}break;
+			default:{
+				r = (uint8_t)rand(); g = (uint8_t)rand(); b = (uint8_t)rand();
+			}break;
+		}
+		*pos++ = g;
+		*pos++ = r;
+		*pos++ = b;
+	}
+}
+
+static void ReadEchos(int fd, tStats *stats){
+	static char line[32];
+	static uint32_t lineLen = 0;
+	char buf[256];
+
+	while(WaitReadable(fd,0.0)){
+		ssize_t n = read(fd,buf,sizeof(buf));
+		if(n <= 0){
+			return;
+		}
+		double now = Now();
+
+		for(ssize_t i = 0; i<n; ++i){
+			if(buf[i] != '\n'){
+				if(lineLen < sizeof(line)-1){
+					line[lineLen++] = buf[i];
+				}
+				continue;
+			}
+			line[lineLen] = 0;
+			lineLen = 0;
+			// the greeting has no line end and can precede the first echo ("AdaF0")
+			char const *echo = strchr(line,'F');
+			if(echo == 0){
+				continue;
+			}
+			uint16_t seq = (uint16_t)strtoul(echo+1,0,10);
+			double latency = now - sendTime[seq];
+			if(stats->framesEchoed == 0 || latency < stats->latencyMin){
+				stats->latencyMin = latency;
+			}
+			if(latency > stats->latencyMax){
+				stats->latencyMax = latency;
+			}
+			stats->latencySum += latency;
+			stats->framesEchoed++;
+		}
+	}
+}
+
+static void Usage(char const *name){
+	fprintf(stderr,
+		"usage: %s -d device [-b baud] [-n leds] [-f fps] [-t seconds] [-p pattern] [-w]\n"
+		"  -d  serial device, e.g. /dev/ttyUSB0 or the pty of adalight_pty_slave\n"
+		"  -b  baud rate (default 115200)\n"
+		"  -n  number of leds per frame (default 100)\n"
+		"  -f  frames per second, 0 = line rate (default 0)\n"
+		"  -t  duration in seconds (default 10)\n"
+		"  -p  solid | ramp | rainbow | random (default rainbow)\n"
+		"  -w  wait for the \"Ada\" greeting of the slave first\n",name);
+}
+
+int main(int argc, char **argv){
+	tOptions opt = {0, 115200, 100, 0.0, 10.0, Pattern_Rainbow, 0};
+	int c;
+
+	while((c = getopt(argc,argv,"d:b:n:f:t:p:wh")) != -1){
+		switch(c){
+			case 'd': opt.device = optarg; break;
+			case 'b': opt.baud = (uint32_t)strtoul(optarg,0,10); break;
+			case 'n': opt.leds = (uint32_t)strtoul(optarg,0,10); break;
+			case 'f': opt.fps = atof(optarg); break;
+			case 't': opt.duration = atof(optarg); break;
+			case 'p':{
+				if(strcmp(optarg,"solid") == 0){ opt.pattern = Pattern_Solid; }
+				else if(strcmp(optarg,"ramp") == 0){ opt.pattern = Pattern_Ramp; }
+				else if(strcmp(optarg,"rainbow") == 0){ opt.pattern = Pattern_Rainbow; }
+				else if(strcmp(optarg,"random") == 0){ opt.pattern = Pattern_Random; }
+				else{ Usage(argv[0]); return 1; }
+			}break;
+			case 'w': opt.waitGreeting = 1; break;
+			default: Usage(argv[0]); return 1;
+		}
+	}
+
+	if((opt.device == 0) || (opt.leds == 0) || (opt.leds > MAX_LEDS)){
+		Usage(argv[0]);
+		return 1;
+	}
+
+	int fd = OpenDevice(&opt);
+	if(fd < 0){
+		return 1;
+	}
+
+	if(opt.waitGreeting && !WaitGreeting(fd,5.0)){
+		fprintf(stderr,"no greeting received\n");
+		close(fd);
+		return 1;
+	}
+
+	uint32_t frameSize = 6 + 3*opt.leds;
+	uint8_t *frame = malloc(frameSize);
+	tStats stats;
+	memset(&stats,0,sizeof(stats));
+
+	double period = (opt.fps > 0.0) ? 1.0/opt.fps : 0.0;
+	double start = Now();
+	double next = start;
+	uint16_t seq = 0;
+
+	while(Now() - start < opt.duration){
+		if(period > 0.0){
+			double now = Now();
+			if(now - next > period){
+				stats.framesLate++;
+			}
+			// collect the echos while waiting, so they get timestamped on arrival
+			while(now < next){
+				WaitReadable(fd,next - now);
+				ReadEchos(fd,&stats);
+				now = Now();
+			}
+			next += period;
+		}
+
+		BuildFrame(frame,&opt,seq);
+		sendTime[seq] = Now();
+
+		uint32_t written = 0;
+		while(written < frameSize){
+			ssize_t n = write(fd,frame+written,frameSize-written);
+			if(n < 0){
+				if(errno == EINTR || errno == EAGAIN){
+					continue;
+				}
+				perror("write");
+				close(fd);
+				free(frame);
+				return 1;
+			}
+			written += n;
+		}
+		stats.framesSent++;
+		stats.bytesSent += frameSize;
+		seq++;
+
+		ReadEchos(fd,&stats);
+	}
+
+	tcdrain(fd);
+	double elapsed = Now() - start;
+
+	// wait for the outstanding echos
+	double drainEnd = Now() + 0.5;
+	while(Now() < drainEnd){
+		WaitReadable(fd,0.01);
+		ReadEchos(fd,&stats);
+	}
+
+	printf("leds:          %u\n",opt.leds);
+	printf("frames sent:   %llu (%.1f fps, %llu late)\n",(unsigned long long)stats.framesSent,
+	       stats.framesSent/elapsed,(unsigned long long)stats.framesLate);
+	printf("throughput:    %.0f bytes/s\n",stats.bytesSent/elapsed);
+	if(stats.framesEchoed != 0){
+		printf("frames echoed: %llu (%llu lost)\n",(unsigned long long)stats.framesEchoed,
+		       (unsigned long long)(stats.framesSent - stats.framesEchoed));
+		printf("latency:       min %.3f ms, avg %.3f ms, max %.3f ms\n",stats.latencyMin*1e3,
+		       stats.latencySum*1e3/stats.framesEchoed,stats.latencyMax*1e3);
+	}
+
+	close(fd);
+	free(frame);
+	return 0;
+}
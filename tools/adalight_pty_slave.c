@@ -0,0 +1,189 @@
+/**
+  ******************************************************************************
+  * @file    adalight_pty_slave.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Host build of the Adalight slave listening on a pseudo terminal
+  *
+  * Runs the unmodified src/adalight_slave.c parser with stubs for UART1 and
+  * the systick. Every received frame gets echoed as "F<seq>\n" with the
+  * sequence number adalight_loadgen puts into the first led. Once per second
+  * the received frames, lost frames, throughput and the parser cost per byte
+  * get printed.
+  *
+  * Build: gcc -O2 -DSTM32F10X_MD -Iinclude -ICMSIS/core -ICMSIS/device
+  *            -IStdPeriph_Driver/inc -o adalight_pty_slave
+  *            tools/adalight_pty_slave.c src/adalight_slave.c
+  * Usage: ./adalight_pty_slave, then ./adalight_loadgen -d <printed pty>
+  ******************************************************************************
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/select.h>
+
+#include "adalight_slave.h"
+
+#define SEQ_MARKER    (0xA5)
+
+static int ptyFd = -1;
+static void (*parser)(uint8_t ch) = 0;
+static volatile sig_atomic_t running = 1;
+
+static uint16_t frameSeq = 0;
+static uint8_t  frameSeqValid = 0;
+static uint8_t  lastSeqValid = 0;
+static uint16_t lastSeq = 0;
+static uint64_t frames = 0;
+static uint64_t framesLost = 0;
+static uint64_t bytes = 0;
+static uint64_t parserNs = 0;
+
+static uint64_t NowNs(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+/* stubs for the target peripherals ------------------------------------------*/
+void UART1_init(uint32_t baud){
+	(void)baud;
+}
+
+void UART1_SetReceiveParser(void (*ParserFunc)(uint8_t ch)){
+	parser = ParserFunc;
+}
+
+void UART1_SendChar(uint8_t ch){
+	if(write(ptyFd,&ch,1) < 0){
+		perror("write");
+	}
+}
+
+void UART1_SendString(char const *str){
+	if(write(ptyFd,str,strlen(str)) < 0){
+		perror("write");
+	}
+}
+
+uint32_t Systick_GetMillis(void){
+	return (uint32_t)(NowNs()/1000000ull);
+}
+
+/* slave callbacks -----------------------------------------------------------*/
+static void colorReceived(uint32_t ledNum, tAdalight_RGB color){
+	if(ledNum == 0){
+		frameSeq = (uint16_t)((color.g << 8) | color.r);
+		frameSeqValid = (color.b == SEQ_MARKER);
+	}
+}
+
+static void frameReceived(void){
+	frames++;
+
+	if(!frameSeqValid){
+		return;
+	}
+	// adalight_loadgen starts every run with 0
+	if(lastSeqValid && (frameSeq != 0)){
+		framesLost += (uint16_t)(frameSeq - lastSeq - 1);
+	}
+	lastSeq = frameSeq;
+	lastSeqValid = 1;
+
+	char echo[16];
+	int len = snprintf(echo,sizeof(echo),"F%u\n",frameSeq);
+	if(write(ptyFd,echo,len) < 0){
+		perror("write");
+	}
+}
+
+static void Stop(int sig){
+	(void)sig;
+	running = 0;
+}
+
+static void MakeRaw(int fd){
+	struct termios tio;
+	if(tcgetattr(fd,&tio) == 0){
+		cfmakeraw(&tio);
+		tcsetattr(fd,TCSANOW,&tio);
+	}
+}
+
+int main(void){
+	ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if((ptyFd < 0) || (grantpt(ptyFd) != 0) || (unlockpt(ptyFd) != 0)){
+		perror("posix_openpt");
+		return 1;
+	}
+
+	// keep the slave side open and raw, so clients can reconnect
+	char const *name = ptsname(ptyFd);
+	int slaveFd = open(name,O_RDWR | O_NOCTTY);
+	if(slaveFd < 0){
+		perror(name);
+		return 1;
+	}
+	MakeRaw(slaveFd);
+	MakeRaw(ptyFd);
+
+	signal(SIGINT,Stop);
+	signal(SIGTERM,Stop);
+
+	Adalight_Slave_SetColorReceivedCallback(colorReceived);
+	Adalight_Slave_SetFrameCompleteCallback(frameReceived);
+	Adalight_Slave_Init();
+
+	printf("adalight slave listening on %s\n",name);
+	fflush(stdout);
+
+	uint64_t lastReport = NowNs();
+	uint64_t lastFrames = 0;
+	uint64_t lastBytes = 0;
+
+	while(running){
+		fd_set set;
+		FD_ZERO(&set);
+		FD_SET(ptyFd,&set);
+		struct timeval tv = {0, 100000};
+
+		if(select(ptyFd+1,&set,0,0,&tv) > 0){
+			uint8_t buf[4096];
+			ssize_t n = read(ptyFd,buf,sizeof(buf));
+			if(n > 0){
+				uint64_t start = NowNs();
+				for(ssize_t i = 0; i<n; ++i){
+					parser(buf[i]);
+				}
+				parserNs += NowNs() - start;
+				bytes += n;
+			}
+		}
+
+		uint64_t now = NowNs();
+		if(now - lastReport >= 1000000000ull){
+			double elapsed = (now - lastReport)*1e-9;
+			printf("frames %llu (%.1f fps), lost %llu, %.0f bytes/s, parser %.1f ns/byte\n",
+			       (unsigned long long)frames,(frames - lastFrames)/elapsed,(unsigned long long)framesLost,
+			       (bytes - lastBytes)/elapsed,bytes ? (double)parserNs/bytes : 0.0);
+			fflush(stdout);
+			lastReport = now;
+			lastFrames = frames;
+			lastBytes = bytes;
+		}
+	}
+
+	close(slaveFd);
+	close(ptyFd);
+	return 0;
+}
@@ -0,0 +1,218 @@
+/**
+  ******************************************************************************
+  * @file    stm32f10x.h
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Host stand-in for the device header and the StdPeriph drivers
+  *
+  * Just enough of the registers and driver functions for a host build of
+  * src/ws2812.c. The registers are plain structs, the driver functions get
+  * implemented by the peripheral model of tools/ws2812_sim.c. The
+  * stm32f10x_xxx.h headers of the drivers in this directory include this one.
+  ******************************************************************************
+*/
+
+#ifndef HOST_STM32F10X_H
+#define HOST_STM32F10X_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+
+typedef enum{
+	DMA1_Channel1_IRQn = 11,
+	DMA1_Channel5_IRQn = 15,
+	TIM3_IRQn          = 29,
+}IRQn_Type;
+
+/* registers -----------------------------------------------------------------*/
+typedef struct{
+	__IO uint16_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR, CCR1, CCR2, CCR3, CCR4;
+}TIM_TypeDef;
+
+typedef struct{
+	__IO uint32_t CCR, CNDTR, CPAR, CMAR;
+}DMA_Channel_TypeDef;
+
+typedef struct{
+	__IO uint16_t CR1, CR2, SR, DR;
+}SPI_TypeDef;
+
+extern TIM_TypeDef         hostTIM3, hostTIM4;
+extern DMA_Channel_TypeDef hostDMA1_Channel1, hostDMA1_Channel5;
+extern SPI_TypeDef         hostSPI2;
+
+#define TIM3               (&hostTIM3)
+#define TIM4               (&hostTIM4)
+#define DMA1_Channel1      (&hostDMA1_Channel1)
+#define DMA1_Channel5      (&hostDMA1_Channel5)
+#define SPI2               (&hostSPI2)
+#define GPIOB              ((void *)0)
+
+#define TIM_CCMR1_OC1M     ((uint16_t)0x0070)
+#define SPI_CR1_BR         ((uint16_t)0x0038)
+#define SPI_CR1_SPE        ((uint16_t)0x0040)
+#define DMA_CCR1_EN        ((uint16_t)0x0001)
+
+/* core ----------------------------------------------------------------------*/
+extern uint32_t SystemCoreClock;
+extern uint32_t hostIrqDisabled;    /**< __disable_irq nesting, the model doesn't raise interrupts meanwhile */
+
+static inline void __disable_irq(void){ hostIrqDisabled++; }
+static inline void __enable_irq(void){ hostIrqDisabled--; }
+static inline void NVIC_EnableIRQ(IRQn_Type irq){ (void)irq; }
+static inline void NVIC_DisableIRQ(IRQn_Type irq){ (void)irq; }
+
+static inline uint32_t __RBIT(uint32_t value){
+	uint32_t result = 0;
+	for(uint32_t i = 0; i<32; ++i){
+		result = (result << 1) | ((value >> i) & 1);
+	}
+	return result;
+}
+
+typedef struct{
+	uint8_t NVIC_IRQChannel;
+	uint8_t NVIC_IRQChannelPreemptionPriority;
+	uint8_t NVIC_IRQChannelSubPriority;
+	FunctionalState NVIC_IRQChannelCmd;
+}NVIC_InitTypeDef;
+void NVIC_Init(NVIC_InitTypeDef *init);
+
+/* rcc -----------------------------------------------------------------------*/
+#define RCC_APB2Periph_GPIOB   ((uint32_t)0x00000008)
+#define RCC_APB1Periph_TIM3    ((uint32_t)0x00000002)
+#define RCC_APB1Periph_TIM4    ((uint32_t)0x00000004)
+#define RCC_APB1Periph_SPI2    ((uint32_t)0x00004000)
+#define RCC_AHBPeriph_DMA1     ((uint32_t)0x00000001)
+#define RCC_AHBPeriph_CRC      ((uint32_t)0x00000040)
+
+typedef struct{
+	uint32_t SYSCLK_Frequency, HCLK_Frequency, PCLK1_Frequency, PCLK2_Frequency, ADCCLK_Frequency;
+}RCC_ClocksTypeDef;
+
+void RCC_APB2PeriphClockCmd(uint32_t periph, FunctionalState state);
+void RCC_APB1PeriphClockCmd(uint32_t periph, FunctionalState state);
+void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state);
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks);
+
+/* gpio ----------------------------------------------------------------------*/
+#define GPIO_Pin_6             ((uint16_t)0x0040)
+#define GPIO_Pin_15            ((uint16_t)0x8000)
+typedef enum{ GPIO_Speed_50MHz = 3 }GPIOSpeed_TypeDef;
+typedef enum{ GPIO_Mode_AF_PP = 0x18 }GPIOMode_TypeDef;
+
+typedef struct{
+	uint16_t GPIO_Pin;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOMode_TypeDef GPIO_Mode;
+}GPIO_InitTypeDef;
+void GPIO_Init(void *gpio, GPIO_InitTypeDef *init);
+
+/* dma -----------------------------------------------------------------------*/
+#define DMA_DIR_PeripheralDST            ((uint32_t)0x00000010)
+#define DMA_PeripheralInc_Disable        ((uint32_t)0x00000000)
+#define DMA_MemoryInc_Enable             ((uint32_t)0x00000080)
+#define DMA_PeripheralDataSize_Byte      ((uint32_t)0x00000000)
+#define DMA_PeripheralDataSize_HalfWord  ((uint32_t)0x00000100)
+#define DMA_MemoryDataSize_Byte          ((uint32_t)0x00000000)
+#define DMA_Mode_Circular                ((uint32_t)0x00000020)
+#define DMA_Mode_Normal                  ((uint32_t)0x00000000)
+#define DMA_Priority_High                ((uint32_t)0x00002000)
+#define DMA_M2M_Disable                  ((uint32_t)0x00000000)
+#define DMA_IT_TC                        ((uint32_t)0x00000002)
+#define DMA_IT_HT                        ((uint32_t)0x00000004)
+#define DMA1_IT_TC1                      ((uint32_t)0x00000002)
+#define DMA1_IT_HT1                      ((uint32_t)0x00000004)
+#define DMA1_IT_TC5                      ((uint32_t)0x00020000)
+#define DMA1_IT_HT5                      ((uint32_t)0x00040000)
+
+typedef struct{
+	uint32_t DMA_PeripheralBaseAddr, DMA_MemoryBaseAddr, DMA_DIR, DMA_BufferSize, DMA_PeripheralInc,
+	         DMA_MemoryInc, DMA_PeripheralDataSize, DMA_MemoryDataSize, DMA_Mode, DMA_Priority, DMA_M2M;
+}DMA_InitTypeDef;
+
+void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitTypeDef *init);
+void DMA_Cmd(DMA_Channel_TypeDef *channel, FunctionalState state);
+void DMA_ITConfig(DMA_Channel_TypeDef *channel, uint32_t it, FunctionalState state);
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef *channel, uint16_t count);
+ITStatus DMA_GetITStatus(uint32_t it);
+void DMA_ClearITPendingBit(uint32_t it);
+
+/* tim -----------------------------------------------------------------------*/
+#define TIM_CKD_DIV1                 ((uint16_t)0x0000)
+#define TIM_CounterMode_Up           ((uint16_t)0x0000)
+#define TIM_OCMode_PWM1              ((uint16_t)0x0060)
+#define TIM_OutputState_Enable       ((uint16_t)0x0001)
+#define TIM_ForcedAction_InActive    ((uint16_t)0x0040)
+#define TIM_OPMode_Single            ((uint16_t)0x0008)
+#define TIM_PSCReloadMode_Immediate  ((uint16_t)0x0001)
+#define TIM_DMA_CC1                  ((uint16_t)0x0200)
+#define TIM_IT_Update                ((uint16_t)0x0001)
+#define TIM_IT_CC1                   ((uint16_t)0x0002)
+
+typedef struct{
+	uint16_t TIM_Prescaler, TIM_CounterMode, TIM_Period, TIM_ClockDivision;
+	uint8_t  TIM_RepetitionCounter;
+}TIM_TimeBaseInitTypeDef;
+
+typedef struct{
+	uint16_t TIM_OCMode, TIM_OutputState, TIM_OutputNState, TIM_Pulse, TIM_OCPolarity, TIM_OCNPolarity,
+	         TIM_OCIdleState, TIM_OCNIdleState;
+}TIM_OCInitTypeDef;
+
+void TIM_TimeBaseInit(TIM_TypeDef *tim, TIM_TimeBaseInitTypeDef *init);
+void TIM_OCStructInit(TIM_OCInitTypeDef *init);
+void TIM_OC1Init(TIM_TypeDef *tim, TIM_OCInitTypeDef *init);
+void TIM_OC1PreloadConfig(TIM_TypeDef *tim, uint16_t preload);
+void TIM_ForcedOC1Config(TIM_TypeDef *tim, uint16_t action);
+void TIM_SelectOnePulseMode(TIM_TypeDef *tim, uint16_t mode);
+void TIM_PrescalerConfig(TIM_TypeDef *tim, uint16_t prescaler, uint16_t mode);
+void TIM_SetAutoreload(TIM_TypeDef *tim, uint16_t reload);
+void TIM_Cmd(TIM_TypeDef *tim, FunctionalState state);
+void TIM_DMACmd(TIM_TypeDef *tim, uint16_t source, FunctionalState state);
+void TIM_ITConfig(TIM_TypeDef *tim, uint16_t it, FunctionalState state);
+ITStatus TIM_GetITStatus(TIM_TypeDef *tim, uint16_t it);
+void TIM_ClearITPendingBit(TIM_TypeDef *tim, uint16_t it);
+
+/* spi -----------------------------------------------------------------------*/
+#define SPI_Direction_1Line_Tx       ((uint16_t)0xC000)
+#define SPI_Mode_Master              ((uint16_t)0x0104)
+#define SPI_DataSize_8b              ((uint16_t)0x0000)
+#define SPI_CPOL_Low                 ((uint16_t)0x0000)
+#define SPI_CPHA_1Edge               ((uint16_t)0x0000)
+#define SPI_NSS_Soft                 ((uint16_t)0x0200)
+#define SPI_FirstBit_MSB             ((uint16_t)0x0000)
+#define SPI_NSSInternalSoft_Set      ((uint16_t)0x0100)
+#define SPI_I2S_DMAReq_Tx            ((uint16_t)0x0002)
+
+typedef struct{
+	uint16_t SPI_Direction, SPI_Mode, SPI_DataSize, SPI_CPOL, SPI_CPHA, SPI_NSS, SPI_BaudRatePrescaler,
+	         SPI_FirstBit, SPI_CRCPolynomial;
+}SPI_InitTypeDef;
+
+void SPI_StructInit(SPI_InitTypeDef *init);
+void SPI_Init(SPI_TypeDef *spi, SPI_InitTypeDef *init);
+void SPI_Cmd(SPI_TypeDef *spi, FunctionalState state);
+void SPI_NSSInternalSoftwareConfig(SPI_TypeDef *spi, uint16_t nss);
+void SPI_I2S_DMACmd(SPI_TypeDef *spi, uint16_t request, FunctionalState state);
+
+/* crc -----------------------------------------------------------------------*/
+void CRC_ResetDR(void);
+uint32_t CRC_CalcCRC(uint32_t data);
+uint32_t CRC_GetCRC(void);
+
+/* the loops of src/ws2812.c which wait for the output run the peripheral model */
+void Host_Wait(void);
+#define WS2812_WAIT()      Host_Wait()
+
+/* interrupt handlers of src/ws2812.c ----------------------------------------*/
+void DMA1_Channel1_IRQHandler(void);
+void DMA1_Channel5_IRQHandler(void);
+void TIM3_IRQHandler(void);
+
+#endif
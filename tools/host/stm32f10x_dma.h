@@ -0,0 +1,2 @@
+/* host build: the driver declarations live in the stand-in device header */
+#include "stm32f10x.h"
@@ -0,0 +1,1016 @@
+/**
+  ******************************************************************************
+  * @file    ws2812_sim.c
+  * @author  agent
+  * @version V1.0
+  * @date    19.10.2026
+  * @brief   Host simulator of the WS2812 output
+  *
+  * Runs the unmodified src/ws2812.c against a model of TIM4 (PWM backend) or
+  * SPI2 (SPI backend), DMA1 and TIM3 at a 72MHz clock. The output pin (PB6 /
+  * PB15) gets recorded as high and low times and decoded back to bytes. Every
+  * bit gets checked against the datasheet windows of the selected led type
+  * (T0H, T1H, T0L, T1L and the bit period), a low in a frame which is neither
+  * a bit nor a reset is an error and every frame has to end with the reset
+  * time. The decoded frames get compared with the colors which have been set.
+  * At the end the frame rate on the line and the decode throughput of the
+  * host get printed.
+  *
+  * Build: gcc -O2 -no-pie -Itools/host -Iinclude -o ws2812_sim
+  *            tools/ws2812_sim.c src/ws2812.c
+  *        add e.g. -DWS2812_BACKEND=1 or -DWS2812_PIXEL_FORMAT=1 for the other
+  *        configurations. -no-pie keeps the dma buffer below 4GB, the lib hands
+  *        its address to the dma as 32 bit value. The test pattern doesn't
+  *        repeat, -DWS2812_RLE=1 needs -DWS2812_RLE_RUNS=3000
+  *        -DWS2812_RLE_COLORS=3000 for it.
+  * Usage: ./ws2812_sim, exits with 1 if a check failed
+  ******************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "stm32f10x.h"
+#include "ws2812.h"
+
+#define CLOCK_KHZ     (72000)
+#define CHANNELS      (WS2812_RGBW ? 4 : 3)
+#define FRAME_BYTES   (WS2812_MAX_LED_NUM * 4)
+#define KEPT_FRAMES   (4)          /**< decoded frames kept, the older ones get overwritten */
+
+#define WIRE_R        ((WS2812_COLOR_ORDER) & 0x3)
+#define WIRE_G        (((WS2812_COLOR_ORDER) >> 2) & 0x3)
+#define WIRE_B        (((WS2812_COLOR_ORDER) >> 4) & 0x3)
+#define WIRE_W        (((WS2812_COLOR_ORDER) >> 6) & 0x3)
+
+#define TIM_CR1_CEN   ((uint16_t)0x0001)
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+#define OUTPUT_DMA    DMA1_Channel5
+#define DMA_FLAG_HT   DMA1_IT_HT5
+#define DMA_FLAG_TC   DMA1_IT_TC5
+#define OUTPUT_IRQ    DMA1_Channel5_IRQHandler
+#else
+#define OUTPUT_DMA    DMA1_Channel1
+#define DMA_FLAG_HT   DMA1_IT_HT1
+#define DMA_FLAG_TC   DMA1_IT_TC1
+#define OUTPUT_IRQ    DMA1_Channel1_IRQHandler
+#endif
+
+/* datasheet windows in ns, the same numbers as the profiles in src/ws2812.c */
+typedef struct{
+	char const *name;
+	uint32_t bitMin, bitMax, t1hMin, t1hMax, t0hMin, t0hMax, t1lMin, t1lMax, t0lMin, t0lMax, reset;
+}tWindows;
+
+static tWindows const windows[] = {
+	[WS2812_TYPE_WS2812]       = {"WS2812",        650, 1850,   550,  850,   200, 500,   450,  750,   650,  950,   50000},
+	[WS2812_TYPE_WS2812B]      = {"WS2812B",       650, 1850,   650,  950,   250, 550,   300,  600,   700, 1000,   50000},
+	[WS2812_TYPE_SK6812]       = {"SK6812",        650, 1850,   450,  750,   150, 450,   450,  750,   750, 1050,   80000},
+	[WS2812_TYPE_WS2811]       = {"WS2811",       1900, 3100,  1050, 1350,   350, 650,  1150, 1450,  1850, 2150,   50000},
+	[WS2812_TYPE_WS2813]       = {"WS2813",        650, 1850,   580, 1000,   220, 380,   220,  420,   580, 1000,  280000},
+	[WS2812_TYPE_WS2812B_FAST] = {"WS2812B_FAST",  650, 1850,   650,  950,   250, 550,   300,  600,   700, 1000,   50000},
+};
+
+typedef struct{
+	uint8_t  bytes[FRAME_BYTES];
+	uint32_t bits;
+	uint32_t gapNs;            /**< low time after the last bit */
+}tFrame;
+
+/* peripherals ---------------------------------------------------------------*/
+TIM_TypeDef         hostTIM3, hostTIM4;
+DMA_Channel_TypeDef hostDMA1_Channel1, hostDMA1_Channel5;
+SPI_TypeDef         hostSPI2;
+uint32_t SystemCoreClock = CLOCK_KHZ * 1000;
+uint32_t hostIrqDisabled = 0;
+
+static uint64_t now = 0;              /**< clock ticks since the start */
+static uint32_t dmaFlags = 0;         /**< DMA1 interrupt status */
+static uint32_t dmaReload = 0;        /**< transfers per cycle of the output channel */
+static uint32_t dmaPos = 0;
+static uint64_t tim3Start = 0;        /**< clock tick of TIM3 count 0 */
+static uint8_t  tim3Cc1Done = 0;
+#if WS2812_BACKEND == WS2812_BACKEND_PWM
+static uint16_t tim4Preload = 0;      /**< compare value the dma wrote, gets active with the next period */
+#endif
+
+/* line decoder --------------------------------------------------------------*/
+static tWindows const *decodeWindows = &windows[WS2812_LED_TYPE];
+static uint8_t  lineLevel = 0;
+static uint64_t lineTicks = 0;        /**< length of the current run */
+static uint64_t highTicks = 0;        /**< high time of the bit which waits for its low, 0 ... none */
+static uint8_t  frameOpen = 0;
+static tFrame   frames[KEPT_FRAMES];
+static uint32_t framesDecoded = 0;
+static uint64_t bitsDecoded = 0;
+static uint32_t lineErrors = 0;
+static void (*frameHook)(tFrame const *frame) = 0;    /**< gets every decoded frame */
+
+static uint32_t failures = 0;
+static void (*slotHook)(void) = 0;    /**< called once before the next slot, like an interrupt of a receiver */
+
+static uint32_t TicksToNs(uint64_t ticks){
+	return (uint32_t)((ticks * 1000000) / CLOCK_KHZ);
+}
+
+static void Fail(char const *format, ...){
+	va_list args;
+	va_start(args,format);
+	printf("FAIL: ");
+	vprintf(format,args);
+	printf("\n");
+	va_end(args);
+	failures++;
+}
+
+static void Line_Error(char const *format, ...){
+	if(lineErrors++ < 10){
+		va_list args;
+		va_start(args,format);
+		printf("FAIL: frame %u bit %u: ",framesDecoded,frames[framesDecoded % KEPT_FRAMES].bits);
+		vprintf(format,args);
+		printf("\n");
+		va_end(args);
+	}
+	failures++;
+}
+
+static uint8_t InWindow(uint32_t ns, uint32_t min, uint32_t max){
+	return (ns >= min) && (ns <= max);
+}
+
+// classifies one bit by its high time, the low time is checked unless it ends the frame
+static void Decode_Bit(uint64_t high, uint64_t low){
+	tWindows const *w = decodeWindows;
+	tFrame *frame = &frames[framesDecoded % KEPT_FRAMES];
+	uint32_t hNs = TicksToNs(high);
+	uint32_t lNs = TicksToNs(low);
+	uint8_t last = lNs >= w->reset;
+	int32_t bit = -1;
+
+	if(!frameOpen){
+		frameOpen = 1;
+		frame->bits = 0;
+	}
+
+	if(InWindow(hNs,w->t1hMin,w->t1hMax)){
+		bit = 1;
+	}
+	else if(InWindow(hNs,w->t0hMin,w->t0hMax)){
+		bit = 0;
+	}
+	else{
+		Line_Error("high for %uns, neither T0H nor T1H",hNs);
+	}
+
+	if(!last){
+		if(bit == 1 && !InWindow(lNs,w->t1lMin,w->t1lMax)){
+			Line_Error("T1L %uns out of %u...%uns (a stall shorter than the reset?)",lNs,w->t1lMin,w->t1lMax);
+		}
+		if(bit == 0 && !InWindow(lNs,w->t0lMin,w->t0lMax)){
+			Line_Error("T0L %uns out of %u...%uns (a stall shorter than the reset?)",lNs,w->t0lMin,w->t0lMax);
+		}
+		if(!InWindow(hNs + lNs,w->bitMin,w->bitMax)){
+			Line_Error("bit period %uns out of %u...%uns",hNs + lNs,w->bitMin,w->bitMax);
+		}
+	}
+
+	if(frame->bits < FRAME_BYTES * 8){
+		uint8_t *byte = &frame->bytes[frame->bits / 8];
+		*byte = (uint8_t)((*byte << 1) | (bit == 1));
+		frame->bits++;
+	}
+	bitsDecoded++;
+
+	if(last){
+		frame->gapNs = lNs;
+		frameOpen = 0;
+		framesDecoded++;
+		if(frameHook != 0){
+			frameHook(frame);
+		}
+	}
+}
+
+static void Decode_Run(uint8_t level, uint64_t ticks){
+	if(level){
+		highTicks = ticks;
+	}
+	else if(highTicks != 0){
+		Decode_Bit(highTicks,ticks);
+		highTicks = 0;
+	}
+}
+
+static void Line(uint8_t level, uint64_t ticks){
+	if(ticks == 0){
+		return;
+	}
+	if(level != lineLevel){
+		Decode_Run(lineLevel,lineTicks);
+		lineLevel = level;
+		lineTicks = 0;
+	}
+	lineTicks += ticks;
+}
+
+// ends the frame on the line if the low after it is already as long as the reset
+static void Line_Flush(void){
+	if(lineLevel == 0 && highTicks != 0 && TicksToNs(lineTicks) >= decodeWindows->reset){
+		Decode_Bit(highTicks,lineTicks);
+		highTicks = 0;
+	}
+}
+
+/* peripheral model ----------------------------------------------------------*/
+static uint8_t Output_Running(void){
+	return (OUTPUT_DMA->CCR & DMA_CCR1_EN) || (TIM3->CR1 & TIM_CR1_CEN);
+}
+
+// one dma transfer of the output channel, raises the half and the transfer complete interrupts
+static uint8_t Dma_Transfer(void){
+	DMA_Channel_TypeDef *dma = OUTPUT_DMA;
+	uint8_t value = ((uint8_t const *)(uintptr_t)dma->CMAR)[dmaPos++];
+
+	dma->CNDTR--;
+	if((dma->CCR & DMA_Mode_Circular) && dma->CNDTR == dmaReload / 2){
+		dmaFlags |= DMA_FLAG_HT;
+		if(dma->CCR & DMA_IT_HT){
+			OUTPUT_IRQ();
+		}
+	}
+	if(dma->CNDTR == 0){
+		dmaFlags |= DMA_FLAG_TC;
+		if(dma->CCR & DMA_Mode_Circular){
+			dma->CNDTR = dmaReload;
+			dmaPos = 0;
+		}
+		else{
+			dma->CCR &= ~DMA_CCR1_EN;
+		}
+		if(dma->CCR & DMA_IT_TC){
+			OUTPUT_IRQ();
+		}
+	}
+	return value;
+}
+
+// compare 1 and the update of the one pulse latch timer
+static void Run_Tim3(void){
+	while(TIM3->CR1 & TIM_CR1_CEN){
+		uint64_t tick = (uint64_t)TIM3->PSC + 1;
+		uint64_t cc1 = tim3Start + TIM3->CCR1 * tick;
+		uint64_t update = tim3Start + ((uint64_t)TIM3->ARR + 1) * tick;
+
+		if(!tim3Cc1Done && now >= cc1){
+			tim3Cc1Done = 1;
+			TIM3->SR |= TIM_IT_CC1;
+			TIM3_IRQHandler();
+		}
+		else if(now >= update){
+			TIM3->CR1 &= ~TIM_CR1_CEN;
+			TIM3->CNT = 0;
+			TIM3->SR |= TIM_IT_Update;
+			TIM3_IRQHandler();
+		}
+		else{
+			break;
+		}
+	}
+}
+
+#if WS2812_BACKEND == WS2812_BACKEND_SPI
+// one byte of the spi: 8 bits at PCLK1 / 2^(BR + 1), PCLK1 is half the clock
+static void Step_Output(void){
+	uint32_t bitTicks = 2u << (((SPI2->CR1 & SPI_CR1_BR) >> 3) + 1);
+
+	if((SPI2->CR1 & SPI_CR1_SPE) && (OUTPUT_DMA->CCR & DMA_CCR1_EN)){
+		uint8_t value = Dma_Transfer();
+		for(int32_t bit = 7; bit >= 0; --bit){
+			Line((value >> bit) & 1,bitTicks);
+		}
+	}
+	else{
+		Line(0,8 * bitTicks);    // mosi stays low after the zeros
+	}
+	now += 8 * bitTicks;
+}
+#else
+// one pwm period: the update loads the compare value the dma wrote during the last one
+static void Step_Output(void){
+	uint32_t period = (uint32_t)TIM4->ARR + 1;
+	uint32_t high = 0;
+
+	if(TIM4->CR1 & TIM_CR1_CEN){
+		uint16_t active = tim4Preload;
+		if(OUTPUT_DMA->CCR & DMA_CCR1_EN){
+			tim4Preload = Dma_Transfer();
+		}
+		if((TIM4->CCMR1 & TIM_CCMR1_OC1M) == TIM_OCMode_PWM1){
+			high = (active < period) ? active : period;
+		}
+	}
+	Line(1,high);
+	Line(0,period - high);
+	now += period;
+}
+#endif
+
+// advances the model by one output slot (a pwm period or a spi byte)
+static void Step(void){
+	if(hostIrqDisabled != 0){
+		Fail("the peripherals ran with the interrupts disabled");
+		exit(1);
+	}
+	if(slotHook != 0){
+		void (*hook)(void) = slotHook;
+		slotHook = 0;
+		hook();
+	}
+	Run_Tim3();
+	Step_Output();
+	Run_Tim3();
+	Line_Flush();
+}
+
+void Host_Wait(void){
+	Step();
+}
+
+// runs until the output is idle or maxFrames more frames have been decoded
+static void Run(uint32_t maxFrames){
+	uint32_t start = framesDecoded;
+	uint64_t limit = now + (uint64_t)CLOCK_KHZ * 1000 * 10;    // 10s, a hung output fails
+
+	while((Output_Running() || slotHook != 0) && framesDecoded - start < maxFrames){
+		Step();
+		if(now > limit){
+			Fail("the output didn't stop");
+			return;
+		}
+	}
+}
+
+/* StdPeriph stand-ins -------------------------------------------------------*/
+void NVIC_Init(NVIC_InitTypeDef *init){ (void)init; }
+void RCC_APB2PeriphClockCmd(uint32_t periph, FunctionalState state){ (void)periph; (void)state; }
+void RCC_APB1PeriphClockCmd(uint32_t periph, FunctionalState state){ (void)periph; (void)state; }
+void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state){ (void)periph; (void)state; }
+void GPIO_Init(void *gpio, GPIO_InitTypeDef *init){ (void)gpio; (void)init; }
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks){
+	clocks->SYSCLK_Frequency = SystemCoreClock;
+	clocks->HCLK_Frequency = SystemCoreClock;
+	clocks->PCLK1_Frequency = SystemCoreClock / 2;
+	clocks->PCLK2_Frequency = SystemCoreClock;
+	clocks->ADCCLK_Frequency = SystemCoreClock / 6;
+}
+
+void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitTypeDef *init){
+	channel->CPAR = init->DMA_PeripheralBaseAddr;
+	channel->CMAR = init->DMA_MemoryBaseAddr;
+	channel->CNDTR = init->DMA_BufferSize;
+	channel->CCR = init->DMA_DIR | init->DMA_Mode | init->DMA_PeripheralInc | init->DMA_MemoryInc |
+	               init->DMA_PeripheralDataSize | init->DMA_MemoryDataSize | init->DMA_Priority | init->DMA_M2M;
+}
+
+void DMA_Cmd(DMA_Channel_TypeDef *channel, FunctionalState state){
+	if(state != DISABLE){
+		channel->CCR |= DMA_CCR1_EN;
+		dmaReload = channel->CNDTR;    // the channel starts at the memory base address
+		dmaPos = 0;
+	}
+	else{
+		channel->CCR &= ~DMA_CCR1_EN;
+	}
+}
+
+void DMA_ITConfig(DMA_Channel_TypeDef *channel, uint32_t it, FunctionalState state){
+	channel->CCR = (state != DISABLE) ? (channel->CCR | it) : (channel->CCR & ~it);
+}
+
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef *channel, uint16_t count){
+	channel->CNDTR = count;
+}
+
+ITStatus DMA_GetITStatus(uint32_t it){
+	return (dmaFlags & it) ? SET : RESET;
+}
+
+void DMA_ClearITPendingBit(uint32_t it){
+	dmaFlags &= ~it;
+}
+
+void TIM_TimeBaseInit(TIM_TypeDef *tim, TIM_TimeBaseInitTypeDef *init){
+	tim->PSC = init->TIM_Prescaler;
+	tim->ARR = init->TIM_Period;
+}
+
+void TIM_OCStructInit(TIM_OCInitTypeDef *init){
+	memset(init,0,sizeof(*init));
+}
+
+void TIM_OC1Init(TIM_TypeDef *tim, TIM_OCInitTypeDef *init){
+	tim->CCMR1 = (tim->CCMR1 & ~TIM_CCMR1_OC1M) | init->TIM_OCMode;
+	tim->CCER |= init->TIM_OutputState;
+}
+
+void TIM_OC1PreloadConfig(TIM_TypeDef *tim, uint16_t preload){
+	tim->CCMR1 |= preload;
+}
+
+void TIM_ForcedOC1Config(TIM_TypeDef *tim, uint16_t action){
+	tim->CCMR1 = (tim->CCMR1 & ~TIM_CCMR1_OC1M) | action;
+}
+
+void TIM_SelectOnePulseMode(TIM_TypeDef *tim, uint16_t mode){
+	tim->CR1 |= mode;
+}
+
+void TIM_PrescalerConfig(TIM_TypeDef *tim, uint16_t prescaler, uint16_t mode){
+	(void)mode;
+	tim->PSC = prescaler;
+}
+
+void TIM_SetAutoreload(TIM_TypeDef *tim, uint16_t reload){
+	tim->ARR = reload;
+}
+
+void TIM_Cmd(TIM_TypeDef *tim, FunctionalState state){
+	if(state != DISABLE){
+		tim->CR1 |= TIM_CR1_CEN;
+		if(tim == TIM3){
+			tim3Start = now - (uint64_t)TIM3->CNT * ((uint64_t)TIM3->PSC + 1);
+			tim3Cc1Done = TIM3->CNT >= TIM3->CCR1;
+		}
+	}
+	else{
+		tim->CR1 &= ~TIM_CR1_CEN;
+	}
+}
+
+void TIM_DMACmd(TIM_TypeDef *tim, uint16_t source, FunctionalState state){
+	tim->DIER = (state != DISABLE) ? (tim->DIER | source) : (tim->DIER & ~source);
+}
+
+void TIM_ITConfig(TIM_TypeDef *tim, uint16_t it, FunctionalState state){
+	tim->DIER = (state != DISABLE) ? (tim->DIER | it) : (tim->DIER & ~it);
+}
+
+ITStatus TIM_GetITStatus(TIM_TypeDef *tim, uint16_t it){
+	return ((tim->SR & it) && (tim->DIER & it)) ? SET : RESET;
+}
+
+void TIM_ClearITPendingBit(TIM_TypeDef *tim, uint16_t it){
+	tim->SR &= ~it;
+}
+
+void SPI_StructInit(SPI_InitTypeDef *init){
+	memset(init,0,sizeof(*init));
+}
+
+void SPI_Init(SPI_TypeDef *spi, SPI_InitTypeDef *init){
+	spi->CR1 = (spi->CR1 & SPI_CR1_SPE) | init->SPI_Direction | init->SPI_Mode | init->SPI_DataSize |
+	           init->SPI_CPOL | init->SPI_CPHA | init->SPI_NSS | init->SPI_BaudRatePrescaler | init->SPI_FirstBit;
+}
+
+void SPI_Cmd(SPI_TypeDef *spi, FunctionalState state){
+	spi->CR1 = (state != DISABLE) ? (spi->CR1 | SPI_CR1_SPE) : (spi->CR1 & ~SPI_CR1_SPE);
+}
+
+void SPI_NSSInternalSoftwareConfig(SPI_TypeDef *spi, uint16_t nss){ (void)spi; (void)nss; }
+void SPI_I2S_DMACmd(SPI_TypeDef *spi, uint16_t request, FunctionalState state){ (void)spi; (void)request; (void)state; }
+
+// crc unit: crc-32 (0x04C11DB7) over 32 bit words, msb first
+static uint32_t crcValue = 0xFFFFFFFF;
+
+void CRC_ResetDR(void){
+	crcValue = 0xFFFFFFFF;
+}
+
+uint32_t CRC_CalcCRC(uint32_t data){
+	crcValue ^= data;
+	for(uint32_t i = 0; i<32; ++i){
+		crcValue = (crcValue & 0x80000000) ? (crcValue << 1) ^ 0x04C11DB7 : (crcValue << 1);
+	}
+	return crcValue;
+}
+
+uint32_t CRC_GetCRC(void){
+	return crcValue;
+}
+
+/* tests ---------------------------------------------------------------------*/
+static uint8_t wireExpected[FRAME_BYTES];
+
+// color channel k of led, compact formats only get colors they can store exactly
+static uint8_t Pattern(uint32_t led, uint32_t k, uint32_t seed){
+	uint8_t value = (uint8_t)((led * 37 + k * 101 + seed * 53) ^ (led >> 3));
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE || WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+	value = (value & 0x80) ? 255 : 0;
+#endif
+	return value;
+}
+
+// sets numLeds leds and the bytes they are expected as on the wire (neutral correction)
+static void Set_Pattern(uint32_t numLeds, uint32_t seed){
+	for(uint32_t i = 0; i<numLeds; ++i){
+		uint8_t r = Pattern(i,0,seed), g = Pattern(i,1,seed), b = Pattern(i,2,seed);
+		uint8_t *wire = &wireExpected[i * CHANNELS];
+#if WS2812_RGBW
+		uint8_t w = Pattern(i,3,seed);
+		tWS2812_RGBW color = {r,g,b,w};
+		WS2812_SetLedRGBW(i,&color);
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_PALETTE || WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB565
+		w = 0;    // the compact formats drop the white channel
+#endif
+#if WS2812_WHITE_EXTRACTION
+		if(w == 0){
+			w = (r < g) ? r : g;
+			w = (b < w) ? b : w;
+			r -= w;
+			g -= w;
+			b -= w;
+		}
+#endif
+		wire[WIRE_W] = w;
+#else
+		tWS2812_RGB color = {r,g,b};
+		WS2812_SetLed(i,&color);
+#endif
+		wire[WIRE_R] = r;
+		wire[WIRE_G] = g;
+		wire[WIRE_B] = b;
+	}
+}
+
+// compares the last decoded frame with the expected bytes, 16 bit pixels may be dithered up by one.
+// Reports the first difference unless what is 0
+static uint8_t Check_Frame(char const *what, uint32_t numLeds){
+	tFrame const *frame = &frames[(framesDecoded - 1) % KEPT_FRAMES];
+
+	if(framesDecoded == 0 || frame->bits != numLeds * CHANNELS * 8){
+		if(what != 0){
+			Fail("%s: %u leds expected, %u bits decoded",what,numLeds,framesDecoded ? frame->bits : 0);
+		}
+		return 0;
+	}
+	for(uint32_t i = 0; i<numLeds * CHANNELS; ++i){
+		int32_t diff = (int32_t)frame->bytes[i] - wireExpected[i];
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16
+		if(diff != 0 && diff != 1){
+#else
+		if(diff != 0){
+#endif
+			if(what != 0){
+				Fail("%s: led %u byte %u is 0x%02X, expected 0x%02X",what,i / CHANNELS,i % CHANNELS,
+				     frame->bytes[i],wireExpected[i]);
+			}
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// runs until the refreshed frame is on the line: a running frame ends first, repeats and a crossfade or the
+// smoothing don't stop, they run until the expected frame shows up (or for 600 frames)
+static void Run_Frame(uint32_t numLeds){
+	for(uint32_t i = 0; i<600 && Output_Running(); ++i){
+		Run(1);
+		if(Check_Frame(0,numLeds)){
+			return;
+		}
+	}
+}
+
+// sends frames of several lengths with every led type which can be met and checks the line
+static void Test_Profiles(void){
+	static uint32_t const counts[] = {1, 2, 3, 17, 100, WS2812_MAX_LED_NUM};
+
+	for(uint8_t type = 0; type<sizeof(windows)/sizeof(windows[0]); ++type){
+		if(!WS2812_SetTiming(type)){
+			printf("%-13s can't be met at %ukHz, skipped\n",windows[type].name,CLOCK_KHZ);
+			continue;
+		}
+		decodeWindows = &windows[type];
+		uint32_t errors = failures;
+		uint32_t gapMin = 0xFFFFFFFF;
+
+		for(uint32_t c = 0; c<sizeof(counts)/sizeof(counts[0]); ++c){
+			char what[64];
+			snprintf(what,sizeof(what),"%s %u leds",windows[type].name,counts[c]);
+
+			Set_Pattern(counts[c],type + c);
+			uint64_t start = now;
+			uint32_t decoded = framesDecoded;
+			WS2812_Refresh(counts[c]);
+			Run_Frame(counts[c]);
+			Check_Frame(what,counts[c]);
+
+			uint32_t gap = frames[(framesDecoded - 1) % KEPT_FRAMES].gapNs;
+			gapMin = (gap < gapMin) ? gap : gapMin;
+			if(c + 1 == sizeof(counts)/sizeof(counts[0]) && framesDecoded > decoded){
+				double frameMs = (double)(now - start) / CLOCK_KHZ / (framesDecoded - decoded);
+				printf("%-13s %u leds: %.2fms per frame (%.1f fps), shortest reset %uus, %s\n",
+				       windows[type].name,counts[c],frameMs,1000.0 / frameMs,gapMin / 1000,
+				       (failures == errors) ? "ok" : "FAILED");
+			}
+		}
+	}
+	WS2812_SetTiming(WS2812_LED_TYPE);
+	decodeWindows = &windows[WS2812_LED_TYPE];
+}
+
+static void Refresh_Hook(void){
+	uint64_t start = now;
+	WS2812_Refresh(100);
+	if(now != start){
+		Fail("the refresh waited %uus for the output",TicksToNs(now - start) / 1000);
+	}
+}
+
+// a refresh from a receive isr while the frame before is still on the line: it returns at once and the
+// latch isr sends the frame after the running one
+static void Test_BackToBack(void){
+	Set_Pattern(100,1);
+	WS2812_Refresh(100);
+	for(uint32_t i = 0; i<500; ++i){
+		Step();
+	}
+	Set_Pattern(100,2);
+	slotHook = Refresh_Hook;
+	Run(1);
+	Run_Frame(100);
+	Check_Frame("back to back",100);
+	printf("back to back  %s\n",(failures == 0) ? "ok" : "FAILED");
+}
+
+// a brightness change with the output idle sends the frame again with the new table
+static void Test_Brightness(void){
+	uint32_t errors = failures;
+
+	Set_Pattern(100,4);
+	WS2812_Refresh(100);
+	Run_Frame(100);
+	Run(KEPT_FRAMES);    // idle
+
+	WS2812_SetBrightness(0);
+	memset(wireExpected,0,100 * CHANNELS);
+	Run_Frame(100);
+	Check_Frame("brightness 0",100);
+
+	WS2812_SetBrightness(255);
+	Set_Pattern(100,4);    // same colors, only the expected bytes
+	Run_Frame(100);
+	Check_Frame("brightness 255",100);
+	printf("brightness    %s\n",(failures == errors) ? "ok" : "FAILED");
+}
+
+static void Refresh_Held(void){
+	WS2812_Refresh(100);
+}
+
+// a timing change while a frame runs, with a refresh from an isr during the wait: the refreshed frame still
+// goes out with the old timing, the setter switches with the line idle and sends the frame with the new one
+static void Test_Timing(void){
+	uint32_t errors = failures;
+
+	Set_Pattern(100,5);
+	WS2812_Refresh(100);
+	for(uint32_t i = 0; i<500; ++i){
+		Step();
+	}
+	Set_Pattern(100,6);
+
+	for(uint8_t type = 0; type<sizeof(windows)/sizeof(windows[0]); ++type){
+		if(type == WS2812_LED_TYPE){
+			continue;
+		}
+		slotHook = Refresh_Held;
+		if(!WS2812_SetTiming(type)){
+			continue;
+		}
+		if(slotHook != 0){
+			Fail("timing: the setter didn't wait for the running frame");
+		}
+		decodeWindows = &windows[type];
+		Run_Frame(100);
+		Check_Frame("timing change",100);
+
+		WS2812_SetTiming(WS2812_LED_TYPE);
+		decodeWindows = &windows[WS2812_LED_TYPE];
+		Run_Frame(100);
+		Check_Frame("timing back",100);
+		printf("timing        %s during a frame, %s\n",windows[type].name,(failures == errors) ? "ok" : "FAILED");
+		return;
+	}
+	slotHook = 0;
+	printf("timing        no other led type can be met, skipped\n");
+}
+
+#if !WS2812_RLE
+static uint8_t Same_Led(uint32_t a, uint32_t b){
+	tWS2812_RGB x = WS2812_GetLed(a);
+	tWS2812_RGB y = WS2812_GetLed(b);
+	return (x.r == y.r) && (x.g == y.g) && (x.b == y.b);
+}
+
+// WS2812_WriteLeds and WS2812_FillLeds at every word alignment and length up to 3 groups of 4 leds, against
+// WS2812_SetLed into leds 64 and up. The leds around the span have to keep the value of led 63
+static void Test_Spans(void){
+	tWS2812_RGB const border = {7, 8, 9};
+	uint8_t rgb[3 * 13];
+	uint32_t errors = failures;
+
+	for(uint32_t i = 0; i<sizeof(rgb); ++i){
+		rgb[i] = (uint8_t)(i * 37 + 11);
+	}
+	for(uint32_t i = 0; i<13; ++i){
+		WS2812_SetLed(64 + i,(tWS2812_RGB const *)&rgb[3 * i]);
+	}
+	WS2812_SetLed(63,&border);
+	WS2812_SetLed(77,(tWS2812_RGB const *)&rgb[0]);
+
+	for(uint32_t fill = 0; fill<2; ++fill){
+		for(uint32_t first = 0; first<4; ++first){
+			for(uint32_t n = 0; n<=13 && failures == errors; ++n){
+				WS2812_FillLeds(0,first + n + 1,&border);
+				if(fill){
+					WS2812_FillLeds(first,n,(tWS2812_RGB const *)&rgb[0]);
+				}
+				else{
+					WS2812_WriteLeds(first,n,rgb);
+				}
+				for(uint32_t i = 0; i<first + n + 1; ++i){
+					uint32_t ref = (i < first || i >= first + n) ? 63 : fill ? 77 : 64 + i - first;
+					if(!Same_Led(i,ref)){
+						Fail("spans: %s of %u leds at %u, led %u differs",fill ? "fill" : "write",n,first,i);
+					}
+				}
+			}
+		}
+	}
+	printf("spans         write and fill at every alignment, %s\n",(failures == errors) ? "ok" : "FAILED");
+}
+#endif
+
+#if WS2812_RLE
+static void Expect_Led(uint32_t led, tWS2812_RGB const *color){
+	uint8_t *wire = &wireExpected[led * CHANNELS];
+	memset(wire,0,CHANNELS);
+	wire[WIRE_R] = color->r;
+	wire[WIRE_G] = color->g;
+	wire[WIRE_B] = color->b;
+}
+
+// uniform and sparse content: a fill, a few single leds, a gap and sparse leds up to the end of the strip
+static void Test_Rle(void){
+	static tWS2812_RGB const colors[] = {{255,0,0}, {0,255,0}, {0,0,255}, {255,255,0}, {0,255,255}, {255,0,255}};
+	tWS2812_RGB const dark = {0,0,0};
+	uint32_t const numLeds = WS2812_MAX_LED_NUM;
+	uint32_t errors = failures;
+	uint32_t drops = WS2812_GetRleDrops();
+
+	WS2812_FillLeds(0,numLeds / 3,&colors[2]);
+	for(uint32_t i = 0; i<numLeds / 3; ++i){
+		Expect_Led(i,&colors[2]);
+	}
+	for(uint32_t i = numLeds / 3; i<numLeds; ++i){
+		tWS2812_RGB const *color = &dark;
+		if(i < numLeds / 3 + 12){
+			color = &colors[i % 6];
+		}
+		else if(i % 97 == 0){
+			color = &colors[0];
+		}
+		if(color != &dark){
+			WS2812_SetLed(i,color);    // the leds before it get filled dark
+		}
+		Expect_Led(i,color);
+	}
+	WS2812_FillLeds(numLeds - 1,1,&dark);
+
+	WS2812_Refresh(numLeds);
+	Run_Frame(numLeds);
+	Check_Frame("rle",numLeds);
+	if(WS2812_GetRleDrops() != drops){
+		Fail("rle: %u writes dropped",WS2812_GetRleDrops() - drops);
+	}
+
+	WS2812_SetLed(1,&colors[0]);    // below the end of the frame
+	if(WS2812_GetRleDrops() != drops + 1){
+		Fail("rle: a write below the end of the frame didn't get dropped");
+	}
+	printf("rle           %u leds of fills and sparse leds, %s\n",numLeds,(failures == errors) ? "ok" : "FAILED");
+}
+#endif
+
+#if WS2812_POWER_LIMIT
+// 10 white leds at 20mA per channel, refreshed with all of them, 3 of them, all again and after handing out
+// the back buffer (recount). The leds above the refreshed count hold the patterns of the tests before
+static void Test_Power(void){
+	static uint32_t const counts[] = {10, 3, 10, 10};
+	static uint32_t const expectedMa[] = {600, 180, 600, 600};
+	tWS2812_PowerModel const model = {20000, 20000, 20000, 20000, 0};
+	tWS2812_RGB const white = {255, 255, 255};
+	uint32_t errors = failures;
+
+	WS2812_SetPowerLimit(&model,0);
+	WS2812_FillLeds(0,10,&white);
+	for(uint32_t i = 0; i<sizeof(counts)/sizeof(counts[0]); ++i){
+		if(i == 3){
+			WS2812_GetBackBuffer();
+		}
+		WS2812_Refresh(counts[i]);
+		Run(2);
+		if(WS2812_GetPowerEstimate() != expectedMa[i]){
+			Fail("power: %u white leds estimate %umA, expected %umA",counts[i],WS2812_GetPowerEstimate(),expectedMa[i]);
+		}
+	}
+
+	// half the estimate as budget: every channel byte goes down to about half of 255
+	WS2812_SetPowerLimit(&model,300);
+	WS2812_Refresh(10);
+	Run(KEPT_FRAMES);
+	tFrame const *frame = &frames[(framesDecoded - 1) % KEPT_FRAMES];
+	for(uint32_t i = 0; i<10; ++i){
+		uint8_t max = 0;
+		for(uint32_t k = 0; k<CHANNELS; ++k){
+			max = (frame->bytes[i * CHANNELS + k] > max) ? frame->bytes[i * CHANNELS + k] : max;
+		}
+		if(max < 0x7E || max > 0x81){
+			Fail("power: led %u peaks at 0x%02X with half the budget",i,max);
+			break;
+		}
+	}
+
+	WS2812_SetPowerLimit(&model,0);
+	WS2812_Refresh(10);
+	Run(KEPT_FRAMES);
+	printf("power         10 white leds %umA, 3 of them %umA, %s\n",expectedMa[0],expectedMa[1],
+	       (failures == errors) ? "ok" : "FAILED");
+}
+#endif
+
+#if WS2812_INTERPOLATION
+// a source which refreshes every 8 or 9 output frames: once the average settled, each fade has to be done
+// before the next refresh, an early frame would fade from the old frame again and step back
+static void Test_Crossfade(void){
+	uint32_t const refreshes = 40, settle = 8;
+	uint32_t errors = failures;
+	uint32_t fadeMin = 0xFFFFFFFF, fadeMax = 0;
+
+	for(uint32_t refresh = 0; refresh<refreshes; ++refresh){
+		if(refresh > settle && !Check_Frame(0,100)){
+			Fail("crossfade: refresh %u arrived before the fade reached the frame",refresh);
+		}
+		Set_Pattern(100,10 + refresh);
+		WS2812_Refresh(100);
+
+		uint32_t fade = 0;
+		for(uint32_t i = 0; i<8 + (refresh & 1); ++i){
+			Run(1);
+			if(fade == 0 && Check_Frame(0,100)){
+				fade = i + 1;
+			}
+		}
+		if(refresh > settle && fade != 0){
+			fadeMin = (fade < fadeMin) ? fade : fadeMin;
+			fadeMax = (fade > fadeMax) ? fade : fadeMax;
+		}
+	}
+	Run_Frame(100);
+	printf("crossfade     refresh every 8-9 frames, frame reached after %u-%u of them, %s\n",fadeMin,fadeMax,
+	       (failures == errors) ? "ok" : "FAILED");
+}
+#endif
+
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16 && !WS2812_INTERPOLATION    /* a crossfade changes the frames */
+static uint32_t ditherSums[WS2812_MAX_LED_NUM][CHANNELS];
+static uint32_t ditherFrames = 0;     /**< frames summed, the first one after the refresh gets skipped */
+
+static void Sum_Frame(tFrame const *frame){
+	if(ditherFrames++ == 0 || frame->bits != WS2812_MAX_LED_NUM * CHANNELS * 8){
+		return;
+	}
+	for(uint32_t i = 0; i<WS2812_MAX_LED_NUM * CHANNELS; ++i){
+		ditherSums[i / CHANNELS][i % CHANNELS] += frame->bytes[i];
+	}
+}
+
+// any 256 repeats of a frame show every dither threshold once per led: their sum equals the 16 bit value
+// (the neutral correction maps it to itself, only 0xFF00 and above stay at 0xFF00)
+static void Test_Dither(void){
+	uint32_t const rounds = 8;
+	uint32_t errors = 0;
+
+	for(uint32_t round = 0; round<rounds; ++round){
+		for(uint32_t i = 0; i<WS2812_MAX_LED_NUM; ++i){
+			uint32_t v = ((round * WS2812_MAX_LED_NUM + i) * 13) & 0xFFFF;
+			if(round == 0 && i < 3){
+				v = (i == 0) ? 0 : (i == 1) ? 0xFF00 : 0xFFFF;
+			}
+			tWS2812_RGB16 color = {(uint16_t)v, (uint16_t)(0xFFFF - v), (uint16_t)(v ^ 0x5A5A)};
+			WS2812_SetLed16(i,&color);
+		}
+		memset(ditherSums,0,sizeof(ditherSums));
+		WS2812_TransferComplete();
+		WS2812_Refresh(WS2812_MAX_LED_NUM);
+		while(!WS2812_TransferComplete()){
+			Step();
+		}
+		ditherFrames = 0;
+		frameHook = Sum_Frame;    // the new frame is still open, it ends the gap after the complete isr
+		while(ditherFrames < 257){
+			Step();
+		}
+		frameHook = 0;
+
+		for(uint32_t i = 0; i<WS2812_MAX_LED_NUM; ++i){
+			tWS2812_RGB16 color = WS2812_GetLed16(i);
+			uint16_t values[3] = {color.r, color.g, color.b};
+			uint8_t const wire[3] = {WIRE_R, WIRE_G, WIRE_B};
+			for(uint32_t k = 0; k<3; ++k){
+				uint32_t expected = (values[k] > 0xFF00) ? 0xFF00 : values[k];
+				uint32_t sum = ditherSums[i][wire[k]];
+#if WS2812_RGBW && WS2812_WHITE_EXTRACTION
+				sum += ditherSums[i][WIRE_W];    // each frame moves the same part of r, g and b to white
+#endif
+				if(sum != expected){
+					if(errors++ < 5){
+						Fail("dither: led %u channel %u sums up to 0x%04X instead of 0x%04X",i,k,sum,expected);
+					}
+					else{
+						failures++;
+					}
+				}
+			}
+		}
+	}
+	printf("dither        %u values x 256 frames, %s\n",rounds * WS2812_MAX_LED_NUM * 3,(errors == 0) ? "exact" : "FAILED");
+}
+#endif
+
+// host time to encode, model and decode frames of all leds
+static void Bench_Decode(void){
+	uint32_t const runs = 20;
+	uint64_t bits = bitsDecoded;
+	struct timespec t0, t1;
+
+	Set_Pattern(WS2812_MAX_LED_NUM,3);
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+	for(uint32_t i = 0; i<runs; ++i){
+		WS2812_Refresh(WS2812_MAX_LED_NUM);
+		Run(1);
+	}
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+
+	double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	double leds = (double)(bitsDecoded - bits) / (CHANNELS * 8);
+	printf("decode        %.0f leds in %.3fs, %.2f Mleds/s on the host\n",leds,seconds,leds / seconds / 1e6);
+}
+
+int main(void){
+	if((uintptr_t)&frames > 0xFFFFFFFF){
+		printf("build with -no-pie, the dma address doesn't fit into 32 bit\n");
+		return 1;
+	}
+
+	WS2812_Init();
+
+	printf("WS2812 simulator: %s backend, pixel format %u, %u leds, %u channels\n",
+	       (WS2812_BACKEND == WS2812_BACKEND_SPI) ? "spi" : "pwm",WS2812_PIXEL_FORMAT,WS2812_MAX_LED_NUM,CHANNELS);
+
+	Test_Profiles();
+	Test_BackToBack();
+	Test_Brightness();
+	Test_Timing();
+#if !WS2812_RLE
+	Test_Spans();
+#endif
+#if WS2812_RLE
+	Test_Rle();
+#endif
+#if WS2812_POWER_LIMIT
+	Test_Power();
+#endif
+#if WS2812_INTERPOLATION
+	Test_Crossfade();
+#endif
+#if WS2812_PIXEL_FORMAT == WS2812_FORMAT_RGB16 && !WS2812_INTERPOLATION
+	Test_Dither();
+#endif
+	Bench_Decode();
+
+	if(failures != 0){
+		printf("%u checks failed\n",failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}